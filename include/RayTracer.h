@@ -26,6 +26,15 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <deque>
+#include <functional>
+#include <algorithm>
+#include <memory>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
@@ -58,27 +67,41 @@ namespace ray
 	struct ray_t;
 	struct lumination_t;
 	struct rayhit_t;
+	struct hitrecord_t;
 	struct fragment_t;
 	struct lighting_t;
+	struct fragmentarray_t;
+	struct bounds_t;
 	
 	struct traceable_t;
 	
+	class textureimage_t;
 	class texturefilter_t;
+	class textureregistry_t;
 	class material_t;
 	class light_t;
 	
 	class camera_t;
+	struct raypacket_t;
+	class bvh_t;
 	class tracestack_t;
 	class tracepath_t;
+	class patharena_t;
+	class photo_t;
 	class emitter_t;
 	
+	class threadpool_t;
+	
 	struct scene_t;
 	
 }
 
+#include "RayTracer_simd.h"
 #include "RayTracer_typedef.h"
+#include "RayTracer_thread.h"
 #include "RayTracer_material.h"
 #include "RayTracer_shape.h"
+#include "RayTracer_bvh.h"
 #include "RayTracer_light.h"
 #include "RayTracer_trace.h"
 #include "RayTracer_scene.h"
\ No newline at end of file
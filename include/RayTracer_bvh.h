@@ -0,0 +1,619 @@
+#pragma once
+
+namespace ray
+{
+
+	/// <summary>
+	/// Enumeration for the ways a bounding volume hierarchy can be built.
+	/// </summary>
+	enum BVHTYPE
+	{
+		/// <summary>
+		/// Do not build a hierarchy, every object is tested against every ray.
+		/// </summary>
+		BVHTYPE_NONE,
+		/// <summary>
+		/// Build the hierarchy by minimizing the surface area heuristic.
+		/// </summary>
+		BVHTYPE_SAH,
+		/// <summary>
+		/// Build the hierarchy from the objects sorted by the Morton codes of their centers, much faster to build but slower to trace.
+		/// </summary>
+		BVHTYPE_LBVH
+	};
+
+	/// <summary>
+	/// Contains properties for a single node of a bounding volume hierarchy.
+	/// Nodes are stored depth first, so the first child of an interior node always directly follows it.
+	/// </summary>
+	struct bvhnode_t
+	{
+
+		inline bvhnode_t() :
+			_offset(0),
+			_count(0),
+			_axis(0) {}
+		inline ~bvhnode_t() {}
+
+		/// <summary>
+		/// Gets a value indicating whether or not the node is a leaf.
+		/// </summary>
+		inline bool leaf() const { return this->_count > 0; }
+		
+#if defined(RAYTRACER_SSE)
+		/// <summary>
+		/// Calculates whether or not the given ray passes through the node's box before the given distance, testing all three slabs at once.
+		/// The box is loaded straight from the node, the fourth lane of each load is never read.
+		/// </summary>
+		/// <param name="origin">Origin of the ray.</param>
+		/// <param name="inverse">Reciprocal of each component of the ray's direction.</param>
+		/// <param name="distance">Farthest distance along the ray to accept.</param>
+		inline bool hitbyray(const __m128 origin, const __m128 inverse, const float distance) const
+		{
+			__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&this->_bounds._min.x), origin), inverse);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&this->_bounds._max.x), origin), inverse);
+			__m128 tmin = _mm_min_ps(t0, t1);
+			__m128 tmax = _mm_max_ps(t0, t1);
+			__m128 enter = _mm_max_ss(_mm_max_ss(tmin, _mm_shuffle_ps(tmin, tmin, _MM_SHUFFLE(1, 1, 1, 1))), _mm_max_ss(_mm_movehl_ps(tmin, tmin), _mm_setzero_ps()));
+			__m128 exit = _mm_min_ss(_mm_min_ss(tmax, _mm_shuffle_ps(tmax, tmax, _MM_SHUFFLE(1, 1, 1, 1))), _mm_min_ss(_mm_movehl_ps(tmax, tmax), _mm_set_ss(distance)));
+			return _mm_comile_ss(enter, exit) != 0;
+		}
+#endif
+
+		/// <summary>
+		/// Box enclosing everything below the node.
+		/// </summary>
+		bounds_t _bounds;
+		/// <summary>
+		/// For a leaf the first of its indices, otherwise the index of its second child.
+		/// </summary>
+		uint32_t _offset;
+		/// <summary>
+		/// Number of indices in a leaf, zero for an interior node.
+		/// </summary>
+		uint16_t _count;
+		/// <summary>
+		/// Axis an interior node was split on.
+		/// </summary>
+		uint16_t _axis;
+
+	};
+
+	/// <summary>
+	/// Contains methods and properties for a group of coherent rays that walk a bounding volume hierarchy together,
+	/// such as the primary rays of a block of pixels or the shadow rays of a batch of fragments toward one light.
+	/// The rays are laid out as one flat array per component, so a node's box is tested against several rays per instruction.
+	/// </summary>
+	struct raypacket_t
+	{
+		
+		/// <summary>
+		/// Largest number of rays a packet can hold, one per bit of a lane mask.
+		/// </summary>
+		static const size_t maxsize = 64;
+		
+		inline raypacket_t() :
+			_count(0) {}
+		inline ~raypacket_t() {}
+		
+		/// <summary>
+		/// Adds a ray to the packet, which must not be full.
+		/// </summary>
+		/// <param name="origin">Origin of the ray.</param>
+		/// <param name="forward">Direction of the ray.</param>
+		inline void push_back(const glm::vec3& origin, const glm::vec3& forward)
+		{
+			size_t lane = this->_count++;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				this->_origin[axis][lane] = origin[axis];
+				this->_forward[axis][lane] = forward[axis];
+				this->_inverse[axis][lane] = 1.0f / forward[axis];
+			}
+		}
+		
+		/// <summary>
+		/// Gets a single ray of the packet.
+		/// </summary>
+		/// <param name="lane">Index of the ray in the packet.</param>
+		inline ray_t ray(const size_t lane) const
+		{
+			return ray_t(
+				glm::vec3(this->_origin[0][lane], this->_origin[1][lane], this->_origin[2][lane]),
+				glm::vec3(this->_forward[0][lane], this->_forward[1][lane], this->_forward[2][lane]));
+		}
+		
+		/// <summary>
+		/// Tests the given box against every ray of the given mask, with the same slab test a single ray walks the hierarchy with.
+		/// </summary>
+		/// <param name="bounds">Box to test.</param>
+		/// <param name="mask">Bit mask of the rays to test.</param>
+		/// <param name="distances">Farthest distance to accept along each ray.</param>
+		/// <returns>Bit mask of the rays that pass through the box.</returns>
+		uint64_t hit(const bounds_t& bounds, const uint64_t mask, const float* distances) const;
+		
+		/// <summary>
+		/// Origin of each ray, one array per axis.
+		/// </summary>
+		float _origin[3][maxsize];
+		/// <summary>
+		/// Direction of each ray, one array per axis.
+		/// </summary>
+		float _forward[3][maxsize];
+		/// <summary>
+		/// Reciprocal of the direction of each ray, one array per axis.
+		/// </summary>
+		float _inverse[3][maxsize];
+		/// <summary>
+		/// Number of rays in the packet.
+		/// </summary>
+		size_t _count;
+		
+	};
+	
+	/// <summary>
+	/// Contains methods and properties for the volume a packet of rays sweeps through, as intervals of the rays' origins and reciprocal directions.
+	/// </summary>
+	struct packetfrustum_t
+	{
+		
+		/// <param name="packet">Rays to bound, which must not be empty.</param>
+		packetfrustum_t(const raypacket_t& packet);
+		inline ~packetfrustum_t() {}
+		
+		/// <summary>
+		/// Calculates whether or not every ray of the packet misses the given box before the given distance.
+		/// The intervals are pushed through the slab test, so a box missed here is missed by every single ray.
+		/// Packets whose directions do not share a sign on every axis are never culled.
+		/// </summary>
+		/// <param name="bounds">Box to test.</param>
+		/// <param name="distance">Farthest distance along any ray of the packet to accept.</param>
+		inline bool missed(const bounds_t& bounds, const float distance) const
+		{
+			if (!this->_coherent)
+			{
+				return false;
+			}
+			
+			float enter = 0.0f;
+			float exit = distance;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				bool negative = this->_inversemax[axis] < 0.0f;
+				float nearplane = negative ? bounds._max[axis] : bounds._min[axis];
+				float farplane = negative ? bounds._min[axis] : bounds._max[axis];
+				enter = std::max(enter, lowest(nearplane - this->_originmax[axis], nearplane - this->_originmin[axis], this->_inversemin[axis], this->_inversemax[axis]));
+				exit = std::min(exit, highest(farplane - this->_originmax[axis], farplane - this->_originmin[axis], this->_inversemin[axis], this->_inversemax[axis]));
+			}
+			
+			return enter > exit;
+		}
+		
+		/// <summary>
+		/// Smallest origin of the rays on each axis.
+		/// </summary>
+		glm::vec3 _originmin;
+		/// <summary>
+		/// Largest origin of the rays on each axis.
+		/// </summary>
+		glm::vec3 _originmax;
+		/// <summary>
+		/// Smallest reciprocal direction of the rays on each axis.
+		/// </summary>
+		glm::vec3 _inversemin;
+		/// <summary>
+		/// Largest reciprocal direction of the rays on each axis.
+		/// </summary>
+		glm::vec3 _inversemax;
+		/// <summary>
+		/// Whether or not the directions of every ray share a sign on every axis, and so whether the packet can be culled as a whole.
+		/// </summary>
+		bool _coherent;
+		
+	protected:
+		
+		/// <summary>
+		/// Gets the lowest product of two intervals.
+		/// </summary>
+		static inline float lowest(const float a0, const float a1, const float b0, const float b1) { return std::min(std::min(a0 * b0, a0 * b1), std::min(a1 * b0, a1 * b1)); }
+		
+		/// <summary>
+		/// Gets the highest product of two intervals.
+		/// </summary>
+		static inline float highest(const float a0, const float a1, const float b0, const float b1) { return std::max(std::max(a0 * b0, a0 * b1), std::max(a1 * b0, a1 * b1)); }
+		
+	};
+	
+	/// <summary>
+	/// Gets the index of the lowest set bit of a lane mask, which must not be zero.
+	/// </summary>
+	inline size_t lowestlane(const uint64_t mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, mask);
+		return size_t(index);
+#else
+		return size_t(__builtin_ctzll(mask));
+#endif
+	}
+
+	/// <summary>
+	/// Contains methods and properties for a bounding volume hierarchy over a list of boxes.
+	/// </summary>
+	class bvh_t
+	{
+	public:
+
+		/// <summary>
+		/// Deepest a hierarchy can be, and so the size of the traversal stack.
+		/// </summary>
+		static const size_t maxdepth = 64;
+		/// <summary>
+		/// Largest number of indices a leaf can hold.
+		/// </summary>
+		static const size_t maxleaf = 8;
+		/// <summary>
+		/// Number of bins the centers of a node's objects are sorted into along each axis, to find the split with the lowest surface area heuristic.
+		/// </summary>
+		static const size_t binsize = 16;
+
+		inline bvh_t() {}
+		inline ~bvh_t() {}
+
+		/// <summary>
+		/// Builds the hierarchy over the given boxes on the calling thread, replacing whatever was built before.
+		/// </summary>
+		/// <param name="bounds">Box of every object, the hierarchy's indices refer to this list.</param>
+		/// <param name="type">How to build the hierarchy, none leaves it empty.</param>
+		void build(const std::vector<bounds_t>& bounds, const BVHTYPE type = BVHTYPE_SAH);
+
+		/// <summary>
+		/// Builds the hierarchy over the given boxes, replacing whatever was built before.
+		/// The top levels are split one at a time, with the objects of surface area heuristic splits binned across the pool, until there are
+		/// enough ranges to keep every worker busy, then each range is built into a subtree as its own task and spliced in afterwards.
+		/// Linear hierarchies sort the Morton codes of the objects across the pool first.
+		/// The hierarchy is the same as the one built on the calling thread.
+		/// </summary>
+		/// <param name="bounds">Box of every object, the hierarchy's indices refer to this list.</param>
+		/// <param name="pool">Thread pool to build on.</param>
+		/// <param name="type">How to build the hierarchy, none leaves it empty.</param>
+		void build(const std::vector<bounds_t>& bounds, threadpool_t& pool, const BVHTYPE type = BVHTYPE_SAH);
+
+		/// <summary>
+		/// Gets the surface area heuristic cost of the hierarchy, the expected cost of walking a ray that passes through the root's box
+		/// relative to testing a single object. Lower is better.
+		/// </summary>
+		float cost() const;
+
+		/// <summary>
+		/// Removes every node of the hierarchy.
+		/// </summary>
+		void clear();
+
+		/// <summary>
+		/// Gets a value indicating whether or not nothing has been built.
+		/// </summary>
+		inline bool empty() const { return this->_nodes.empty(); }
+
+		/// <summary>
+		/// Walks the hierarchy front to back along the given ray, testing the objects of every leaf whose box is hit.
+		/// The intersect functor is called once per leaf as intersect(indices, count, distance), so it can test a leaf's objects in batches,
+		/// and may shorten the distance to cull the rest of the walk. It returns true to stop the walk early.
+		/// </summary>
+		/// <param name="ray">Ray to walk the hierarchy with.</param>
+		/// <param name="distance">Farthest distance along the ray to accept.</param>
+		/// <param name="intersect">Functor that tests the objects of a leaf.</param>
+		/// <returns>True if the walk was stopped by the functor.</returns>
+		template <typename T> inline bool traverse(const ray_t& ray, float& distance, T& intersect) const
+		{
+			if (this->_nodes.empty())
+			{
+				return false;
+			}
+
+			glm::vec3 origin(ray._origin);
+			glm::vec3 inverse = 1.0f / ray._forward;
+#if defined(RAYTRACER_SSE)
+			const __m128 origin4 = _mm_setr_ps(origin.x, origin.y, origin.z, 0.0f);
+			const __m128 inverse4 = _mm_setr_ps(inverse.x, inverse.y, inverse.z, 0.0f);
+#endif
+			uint32_t stack[maxdepth];
+			size_t top = 0;
+			uint32_t index = 0;
+			for (;;)
+			{
+				const bvhnode_t& node = this->_nodes[index];
+#if defined(RAYTRACER_SSE)
+				if (node.hitbyray(origin4, inverse4, distance))
+#else
+				if (node._bounds.hitbyray(origin, inverse, distance))
+#endif
+				{
+					if (node.leaf())
+					{
+						if (intersect(&this->_indices[node._offset], node._count, distance))
+						{
+							return true;
+						}
+					}
+					else
+					{
+						bool reverse = inverse[node._axis] < 0.0f;
+						stack[top++] = reverse ? index + 1 : node._offset;
+						index = reverse ? node._offset : index + 1;
+						continue;
+					}
+				}
+
+				if (top == 0)
+				{
+					return false;
+				}
+
+				index = stack[--top];
+			}
+		}
+
+		/// <summary>
+		/// Walks the hierarchy with every ray of a packet at once, so each node is fetched once for the whole packet and its box
+		/// is tested against several rays per instruction. Every ray sees exactly the node tests it would see walking alone: a child
+		/// is only tested against the rays that hit its parent. A node is skipped without testing any ray when the packet misses it as a whole.
+		/// The intersect functor is called as intersect(lane, indices, count, distance) for every ray that hits a leaf's box,
+		/// and returns true to retire the ray from the rest of the walk.
+		/// </summary>
+		/// <param name="packet">Rays to walk the hierarchy with.</param>
+		/// <param name="distances">Farthest distance to accept along each ray, negative for rays that take no part. Retired rays are set to -1.</param>
+		/// <param name="intersect">Functor that tests the objects of a leaf against a single ray.</param>
+		template <typename T> inline void traverse(const raypacket_t& packet, float* distances, T& intersect) const
+		{
+			uint64_t alive = 0;
+			float farthest = 0.0f;
+			for (size_t i = 0; i < packet._count; i++)
+			{
+				if (distances[i] >= 0.0f)
+				{
+					alive |= uint64_t(1) << i;
+					farthest = std::max(farthest, distances[i]);
+				}
+			}
+			
+			if (this->_nodes.empty() || alive == 0)
+			{
+				return;
+			}
+			
+			packetfrustum_t frustum(packet);
+			uint32_t stack[maxdepth];
+			uint64_t masks[maxdepth];
+			size_t top = 0;
+			uint32_t index = 0;
+			uint64_t mask = alive;
+			for (;;)
+			{
+				const bvhnode_t& node = this->_nodes[index];
+				mask &= alive;
+				mask = mask == 0 || frustum.missed(node._bounds, farthest) ? 0 : packet.hit(node._bounds, mask, distances);
+				if (mask != 0)
+				{
+					if (!node.leaf())
+					{
+						// The children are visited in the order the first ray that hit the node would visit them.
+						bool reverse = packet._inverse[node._axis][lowestlane(mask)] < 0.0f;
+						masks[top] = mask;
+						stack[top++] = reverse ? index + 1 : node._offset;
+						index = reverse ? node._offset : index + 1;
+						continue;
+					}
+					
+					for (uint64_t lanes = mask; lanes != 0; lanes &= lanes - 1)
+					{
+						size_t lane = lowestlane(lanes);
+						if (intersect(lane, &this->_indices[node._offset], node._count, distances[lane]))
+						{
+							distances[lane] = -1.0f;
+							alive &= ~(uint64_t(1) << lane);
+						}
+					}
+					
+					if (alive == 0)
+					{
+						return;
+					}
+					
+					farthest = 0.0f;
+					for (uint64_t lanes = alive; lanes != 0; lanes &= lanes - 1)
+					{
+						farthest = std::max(farthest, distances[lowestlane(lanes)]);
+					}
+				}
+				
+				if (top == 0)
+				{
+					return;
+				}
+				
+				index = stack[--top];
+				mask = masks[top];
+			}
+		}
+
+		/// <summary>
+		/// Nodes of the hierarchy, the root is the first node.
+		/// </summary>
+		std::vector<bvhnode_t> _nodes;
+		/// <summary>
+		/// Indices into the built list of boxes, grouped by leaf.
+		/// </summary>
+		std::vector<uint32_t> _indices;
+
+	protected:
+
+		/// <summary>
+		/// Contains properties for an object while the hierarchy is being built. References are partitioned in place
+		/// rather than the indices, so binning a range reads its objects' boxes and centers in order.
+		/// </summary>
+		struct reference_t
+		{
+			
+			/// <summary>
+			/// Box of the object.
+			/// </summary>
+			bounds_t _box;
+			/// <summary>
+			/// Center of the object's box.
+			/// </summary>
+			glm::vec3 _center;
+			/// <summary>
+			/// Index of the object in the built list of boxes.
+			/// </summary>
+			uint32_t _index;
+			
+		};
+
+		/// <summary>
+		/// Contains properties for a range of the references that a node is built over.
+		/// </summary>
+		struct range_t
+		{
+			
+			inline range_t() :
+				_begin(0),
+				_end(0),
+				_depth(0) {}
+			inline ~range_t() {}
+			
+			/// <summary>
+			/// Gets the number of indices in the range.
+			/// </summary>
+			inline size_t count() const { return this->_end - this->_begin; }
+			
+			/// <summary>
+			/// First index in the range.
+			/// </summary>
+			size_t _begin;
+			/// <summary>
+			/// One past the last index in the range.
+			/// </summary>
+			size_t _end;
+			/// <summary>
+			/// Depth of the node built over the range.
+			/// </summary>
+			size_t _depth;
+			/// <summary>
+			/// Box enclosing the boxes of the range's objects.
+			/// </summary>
+			bounds_t _box;
+			/// <summary>
+			/// Box enclosing the centers of the range's objects.
+			/// </summary>
+			bounds_t _spread;
+			/// <summary>
+			/// Nodes of the subtree built over the range when it is built as its own task, its indices start from zero.
+			/// </summary>
+			std::vector<bvhnode_t> _nodes;
+			
+		};
+
+		/// <summary>
+		/// Builds the hierarchy over the given boxes, on the pool if there is one and on the calling thread otherwise.
+		/// </summary>
+		/// <param name="bounds">Box of every object, the hierarchy's indices refer to this list.</param>
+		/// <param name="type">How to build the hierarchy.</param>
+		/// <param name="pool">Thread pool to build on, or null.</param>
+		void build(const std::vector<bounds_t>& bounds, const BVHTYPE type, threadpool_t* pool);
+
+		/// <summary>
+		/// Builds a linear hierarchy over the given boxes, by sorting their Morton codes and splitting each range where the codes first differ.
+		/// </summary>
+		/// <param name="bounds">Box of every object, which must not be empty.</param>
+		/// <param name="pool">Thread pool to build on, or null.</param>
+		void linear(const std::vector<bounds_t>& bounds, threadpool_t* pool);
+
+		/// <summary>
+		/// Finds the split of a range with the lowest surface area heuristic from the bins of its centers, and partitions its references around it.
+		/// </summary>
+		/// <param name="references">Reference to every object, partitioned in place.</param>
+		/// <param name="range">Range to split.</param>
+		/// <param name="pool">Thread pool to bin the range's objects across, or null to bin them on the calling thread.</param>
+		/// <param name="left">Range of the first child.</param>
+		/// <param name="right">Range of the second child.</param>
+		/// <param name="axis">Axis the range was split on.</param>
+		/// <returns>False if the range should be a leaf instead.</returns>
+		bool split(std::vector<reference_t>& references, const range_t& range, threadpool_t* pool, range_t& left, range_t& right, int& axis);
+
+		/// <summary>
+		/// Splits a range of objects sorted by their Morton codes at the highest bit their codes differ in, or in half if they are
+		/// all the same or the range is too deep.
+		/// </summary>
+		/// <param name="codes">Sorted Morton code of every object.</param>
+		/// <param name="range">Range to split.</param>
+		/// <param name="left">Range of the first child.</param>
+		/// <param name="right">Range of the second child.</param>
+		/// <param name="axis">Axis of the bit the range was split at.</param>
+		/// <returns>False if the range should be a leaf instead.</returns>
+		bool split(const std::vector<uint64_t>& codes, const range_t& range, range_t& left, range_t& right, int& axis) const;
+
+		/// <summary>
+		/// Builds the node for a range of the references, and everything below it, into the given list of nodes.
+		/// </summary>
+		/// <param name="nodes">List of nodes to build into.</param>
+		/// <param name="references">Reference to every object, partitioned in place.</param>
+		/// <param name="range">Range to build.</param>
+		/// <returns>Index of the node.</returns>
+		uint32_t build(std::vector<bvhnode_t>& nodes, std::vector<reference_t>& references, const range_t& range);
+
+		/// <summary>
+		/// Builds the node for a range of objects sorted by their Morton codes, and everything below it, into the given list of nodes.
+		/// The boxes of the nodes are gathered on the way back up.
+		/// </summary>
+		/// <param name="nodes">List of nodes to build into.</param>
+		/// <param name="bounds">Box of every object.</param>
+		/// <param name="codes">Sorted Morton code of every object.</param>
+		/// <param name="range">Range to build.</param>
+		/// <returns>Index of the node.</returns>
+		uint32_t build(std::vector<bvhnode_t>& nodes, const std::vector<bounds_t>& bounds, const std::vector<uint64_t>& codes, const range_t& range);
+
+		/// <summary>
+		/// Builds the top levels of the hierarchy over a range, stopping at ranges small enough to be built as their own tasks.
+		/// </summary>
+		/// <param name="nodes">List of the top nodes to build into.</param>
+		/// <param name="owners">Index of the subtree in place of each top node, or nosubtree for nodes that were built here.</param>
+		/// <param name="subtrees">Ranges left to be built as their own tasks.</param>
+		/// <param name="references">Reference to every object, partitioned in place.</param>
+		/// <param name="range">Range to build.</param>
+		/// <param name="grain">Largest range that is left to a task.</param>
+		/// <param name="pool">Thread pool to bin the top levels across.</param>
+		/// <returns>Index of the node.</returns>
+		uint32_t plan(std::vector<bvhnode_t>& nodes, std::vector<uint32_t>& owners, std::vector<range_t>& subtrees, std::vector<reference_t>& references, const range_t& range, const size_t grain, threadpool_t& pool);
+
+		/// <summary>
+		/// Builds the top levels of a linear hierarchy over a range, stopping at ranges small enough to be built as their own tasks.
+		/// </summary>
+		/// <param name="nodes">List of the top nodes to build into.</param>
+		/// <param name="owners">Index of the subtree in place of each top node, or nosubtree for nodes that were built here.</param>
+		/// <param name="subtrees">Ranges left to be built as their own tasks.</param>
+		/// <param name="codes">Sorted Morton code of every object.</param>
+		/// <param name="range">Range to build.</param>
+		/// <param name="grain">Largest range that is left to a task.</param>
+		/// <returns>Index of the node.</returns>
+		uint32_t plan(std::vector<bvhnode_t>& nodes, std::vector<uint32_t>& owners, std::vector<range_t>& subtrees, const std::vector<uint64_t>& codes, const range_t& range, const size_t grain);
+
+		/// <summary>
+		/// Appends a top node and everything below it to the hierarchy depth first, with the subtrees built by the tasks in place of their nodes.
+		/// The boxes of the top interior nodes are gathered from their children.
+		/// </summary>
+		/// <param name="nodes">Top nodes.</param>
+		/// <param name="owners">Index of the subtree in place of each top node, or nosubtree.</param>
+		/// <param name="subtrees">Built subtrees, whose nodes are released once they have been appended.</param>
+		/// <param name="index">Index of the top node to append.</param>
+		void splice(const std::vector<bvhnode_t>& nodes, const std::vector<uint32_t>& owners, std::vector<range_t>& subtrees, const uint32_t index);
+
+		/// <summary>
+		/// Marks a top node that was built by itself rather than left to a subtree.
+		/// </summary>
+		static const uint32_t nosubtree = 0xffffffffu;
+
+	};
+
+}
\ No newline at end of file
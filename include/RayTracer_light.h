@@ -3,6 +3,14 @@
 namespace ray
 {
 	
+	/// <summary>
+	/// Enumeration for the types of lights.
+	/// </summary>
+	enum LIGHTTYPE
+	{
+		LIGHTTYPE_POINT
+	};
+	
 	/// <summary>
 	/// Contains methods and properties for illuminating a traceable surface.
 	/// </summary>
@@ -21,15 +29,27 @@ namespace ray
 		/// Calculates the luminance generated by the light for the given surface fragment.
 		/// </summary>
 		/// <param name="fragment">Surface fragment to illuminate.</param>
+		/// <param name="stack">Stack of objects that can cast shadows on the fragment.</param>
 		/// <returns>Lumination for the surface fragment.</returns>
-		virtual lumination_t luminance(const fragment_t& fragment) = 0;
+		virtual lumination_t luminance(const fragment_t& fragment, const tracestack_t& stack) = 0;
 		
 		/// <summary>
 		/// Calculates a scalar value of how much the given surface fragment is in shadow.
 		/// </summary>
 		/// <param name="fragment">Surface fragment to occlude.</param>
-		/// <returns>Scalar value for how occluded the surface fragment is.</returns>
-		virtual float occlusion(const fragment_t& fragment) = 0;
+		/// <param name="stack">Stack of objects that can cast shadows on the fragment.</param>
+		/// <returns>Scalar value for how much of the light reaches the surface fragment, zero if it is completely in shadow.</returns>
+		virtual float occlusion(const fragment_t& fragment, const tracestack_t& stack) = 0;
+		
+		/// <summary>
+		/// Gets the type of the light.
+		/// </summary>
+		virtual LIGHTTYPE type() const = 0;
+		
+		/// <summary>
+		/// Gets the intensity value of the light.
+		/// </summary>
+		inline float intensity() const { return this->_intensity; }
 		
 	protected:
 		
@@ -62,15 +82,31 @@ namespace ray
 		/// Calculates the luminance generated by the light for the given surface fragment.
 		/// </summary>
 		/// <param name="fragment">Surface fragment to illuminate.</param>
+		/// <param name="stack">Stack of objects that can cast shadows on the fragment.</param>
 		/// <returns>Lumination for the surface fragment.</returns>
-		lumination_t luminance(const fragment_t& fragment);
+		lumination_t luminance(const fragment_t& fragment, const tracestack_t& stack);
 		
 		/// <summary>
 		/// Calculates a scalar value of how much the given surface fragment is in shadow.
 		/// </summary>
 		/// <param name="fragment">Surface fragment to occlude.</param>
-		/// <returns>Scalar value for how occluded the surface fragment is.</returns>
-		float occlusion(const fragment_t& fragment);
+		/// <param name="stack">Stack of objects that can cast shadows on the fragment.</param>
+		/// <returns>Scalar value for how much of the light reaches the surface fragment, zero if it is completely in shadow.</returns>
+		float occlusion(const fragment_t& fragment, const tracestack_t& stack);
+		
+		/// <summary>
+		/// Gets the type of the light.
+		/// </summary>
+		inline LIGHTTYPE type() const { return LIGHTTYPE_POINT; }
+		
+		/// <summary>
+		/// Gets the position of the point light.
+		/// </summary>
+		inline const glm::vec4& position() const { return this->_position; }
+		/// <summary>
+		/// Gets the color of the point light.
+		/// </summary>
+		inline const glm::vec4& color() const { return this->_color; }
 		
 	protected:
 		
@@ -85,4 +121,74 @@ namespace ray
 		
 	};
 	
+	/// <summary>
+	/// Contains methods and properties for a flat, structure of arrays copy of a list of point lights.
+	/// </summary>
+	struct pointlightarray_t
+	{
+		
+		inline pointlightarray_t() {}
+		inline ~pointlightarray_t() {}
+		
+		/// <summary>
+		/// Gets the number of point lights in the array.
+		/// </summary>
+		inline size_t size() const { return this->_intensity.size(); }
+		
+		/// <summary>
+		/// Removes every point light from the array.
+		/// </summary>
+		void clear();
+		
+		/// <summary>
+		/// Appends a copy of the given point light to the array.
+		/// </summary>
+		/// <param name="light">Point light to copy.</param>
+		void push_back(const pointlight_t* light);
+		
+		/// <summary>
+		/// Gets the position of a single point light.
+		/// </summary>
+		/// <param name="index">Index of the light.</param>
+		inline glm::vec3 position(const size_t index) const { return glm::vec3(this->_x[index], this->_y[index], this->_z[index]); }
+		
+		/// <summary>
+		/// Gets the lighting data of a single point light on the given surface fragment.
+		/// </summary>
+		/// <param name="index">Index of the light.</param>
+		/// <param name="fragment">Surface fragment being lit.</param>
+		/// <param name="occlusion">How much of the light reaches the fragment.</param>
+		inline lighting_t lighting(const size_t index, const fragment_t& fragment, const float occlusion) const { return lighting_t(glm::normalize(this->position(index) - glm::vec3(fragment._position)), occlusion); }
+		
+		/// <summary>
+		/// Position of each light on the X-axis.
+		/// </summary>
+		std::vector<float> _x;
+		/// <summary>
+		/// Position of each light on the Y-axis.
+		/// </summary>
+		std::vector<float> _y;
+		/// <summary>
+		/// Position of each light on the Z-axis.
+		/// </summary>
+		std::vector<float> _z;
+		/// <summary>
+		/// Red color channel of each light.
+		/// </summary>
+		std::vector<float> _r;
+		/// <summary>
+		/// Green color channel of each light.
+		/// </summary>
+		std::vector<float> _g;
+		/// <summary>
+		/// Blue color channel of each light.
+		/// </summary>
+		std::vector<float> _b;
+		/// <summary>
+		/// Intensity value of each light.
+		/// </summary>
+		std::vector<float> _intensity;
+		
+	};
+	
 }
\ No newline at end of file
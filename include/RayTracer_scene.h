@@ -9,13 +9,16 @@ namespace ray
     struct scene_t
     {
         
-        inline scene_t() {}
+        inline scene_t() :
+            _bvh(BVHTYPE_SAH) {}
         inline ~scene_t() {}
         
         std::string _filename;
         glm::ivec2 _photo;
+        BVHTYPE _bvh;
         camera_t _camera;
         tracestack_t _stack;
+        textureregistry_t _textures;
         
     };
     
@@ -3,6 +3,28 @@
 namespace ray
 {
 
+	/// <summary>
+	/// Enumeration for the types of traceable shapes.
+	/// </summary>
+	enum SHAPETYPE
+	{
+		SHAPETYPE_SPHERE,
+		SHAPETYPE_AXISCUBE
+	};
+
+	/// <summary>
+	/// Packs a shape type and an index into that type's flat array into a single primitive id.
+	/// </summary>
+	inline uint32_t primitiveid(const SHAPETYPE type, const size_t index) { return (uint32_t(type) << 28) | uint32_t(index); }
+	/// <summary>
+	/// Gets the shape type of a primitive id.
+	/// </summary>
+	inline SHAPETYPE primitivetype(const uint32_t id) { return SHAPETYPE(id >> 28); }
+	/// <summary>
+	/// Gets the index into the flat array of a primitive id.
+	/// </summary>
+	inline size_t primitiveindex(const uint32_t id) { return size_t(id & 0x0fffffff); }
+
 	/// <summary>
 	/// Contains methods and properties for a shape that is traceable by a ray.
 	/// </summary>
@@ -33,6 +55,17 @@ namespace ray
 		/// <returns>Surface fragment of the shape.</returns>
 		virtual fragment_t fragmentate(const rayhit_t& hit) const = 0;
 		
+		/// <summary>
+		/// Gets the box that encloses the shape.
+		/// </summary>
+		/// <returns>Axis-aligned bounds of the shape.</returns>
+		virtual bounds_t bounds() const = 0;
+		
+		/// <summary>
+		/// Gets the type of the shape.
+		/// </summary>
+		virtual SHAPETYPE type() const = 0;
+		
 		/// <summary>
 		/// Material that is attached to the shape.
 		/// </summary>
@@ -73,6 +106,26 @@ namespace ray
 		/// <returns>Surface fragment of the shape.</returns>
 		fragment_t fragmentate(const rayhit_t& hit) const;
 		
+		/// <summary>
+		/// Gets the box that encloses the shape.
+		/// </summary>
+		/// <returns>Axis-aligned bounds of the shape.</returns>
+		bounds_t bounds() const;
+		
+		/// <summary>
+		/// Gets the type of the shape.
+		/// </summary>
+		inline SHAPETYPE type() const { return SHAPETYPE_SPHERE; }
+		
+		/// <summary>
+		/// Gets the center of the sphere.
+		/// </summary>
+		inline const glm::vec4& center() const { return this->_center; }
+		/// <summary>
+		/// Gets the radius of the sphere.
+		/// </summary>
+		inline glm::vec4::value_type radius() const { return this->_radius; }
+		
 	protected:
 
 		/// <summary>
@@ -86,6 +139,12 @@ namespace ray
 
 	};
 
+	/// <summary>
+	/// Nearest distance along a ray at which an axis-aligned cube can be hit.
+	/// Kept under the bias secondary rays are started off a surface with, so cubes right next to that surface still shadow and reflect.
+	/// </summary>
+	static const float cubeepsilon = 0.0001f;
+	
 	/// <summary>
 	/// Contains methods and properties for a traceable axis-aligned cube.
 	/// </summary>
@@ -126,6 +185,26 @@ namespace ray
 		/// <returns>Surface fragment of the shape.</returns>
 		fragment_t fragmentate(const rayhit_t& hit) const;
 		
+		/// <summary>
+		/// Gets the box that encloses the shape.
+		/// </summary>
+		/// <returns>Axis-aligned bounds of the shape.</returns>
+		bounds_t bounds() const;
+		
+		/// <summary>
+		/// Gets the type of the shape.
+		/// </summary>
+		inline SHAPETYPE type() const { return SHAPETYPE_AXISCUBE; }
+		
+		/// <summary>
+		/// Gets the lowest corner of the cube.
+		/// </summary>
+		inline const glm::vec4& p0() const { return this->_p0; }
+		/// <summary>
+		/// Gets the highest corner of the cube.
+		/// </summary>
+		inline const glm::vec4& p1() const { return this->_p1; }
+		
 	protected:
 
 		/// <summary>
@@ -139,4 +218,227 @@ namespace ray
 
 	};
 
+	/// <summary>
+	/// Contains methods and properties for a flat, structure of arrays copy of a list of spheres.
+	/// </summary>
+	struct spherearray_t
+	{
+		
+		inline spherearray_t() {}
+		inline ~spherearray_t() {}
+		
+		/// <summary>
+		/// Gets the number of spheres in the array.
+		/// </summary>
+		inline size_t size() const { return this->_radius.size(); }
+		
+		/// <summary>
+		/// Removes every sphere from the array.
+		/// </summary>
+		void clear();
+		
+		/// <summary>
+		/// Appends a copy of the given sphere to the array.
+		/// </summary>
+		/// <param name="sphere">Sphere to copy.</param>
+		void push_back(const tracesphere_t* sphere);
+		
+		/// <summary>
+		/// Calculates the distance along the given ray to a single sphere of the array.
+		/// </summary>
+		/// <param name="index">Index of the sphere.</param>
+		/// <param name="ray">A ray to intersect with the sphere.</param>
+		/// <param name="distance">Distance to the hit, only written if the ray hits the sphere.</param>
+		inline bool hitbyray(const size_t index, const ray_t& ray, float& distance) const
+		{
+			float px = ray._origin.x - this->_x[index];
+			float py = ray._origin.y - this->_y[index];
+			float pz = ray._origin.z - this->_z[index];
+			float a = glm::dot(ray._forward, ray._forward);
+			float b = 2.0f * ((px * ray._forward.x) + (py * ray._forward.y) + (pz * ray._forward.z));
+			float c = ((px * px) + (py * py) + (pz * pz)) - (this->_radius[index] * this->_radius[index]);
+			float d = (b * b) - (4.0f * a * c);
+			if (d >= 0.0f)
+			{
+				float t = (-b - sqrt(d)) / (2.0f * a);
+				if (t >= 0.0f)
+				{
+					distance = t;
+					return true;
+				}
+			}
+			
+			return false;
+		}
+		
+		/// <summary>
+		/// Finds the nearest sphere in a range of the array hit by the given ray, testing as many spheres at once as the processor allows.
+		/// Every kernel solves the same quadratic as hitbyray, so they all agree on the distance and on ties.
+		/// </summary>
+		/// <param name="ray">A ray to intersect with the spheres.</param>
+		/// <param name="begin">Index of the first sphere to test.</param>
+		/// <param name="end">One past the index of the last sphere to test.</param>
+		/// <param name="distance">Only hits nearer than this are accepted, updated with the nearest hit.</param>
+		/// <param name="index">Index of the nearest sphere, only written if one is hit.</param>
+		/// <returns>True if a sphere nearer than the given distance is hit.</returns>
+		bool nearest(const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index) const;
+		
+		/// <summary>
+		/// Calculates whether or not any sphere in a range of the array is hit by the given ray before the given distance,
+		/// returning as soon as one is found.
+		/// </summary>
+		/// <param name="ray">A ray to intersect with the spheres.</param>
+		/// <param name="begin">Index of the first sphere to test.</param>
+		/// <param name="end">One past the index of the last sphere to test.</param>
+		/// <param name="distance">Only hits nearer than this are accepted.</param>
+		bool occluded(const ray_t& ray, const size_t begin, const size_t end, const float distance) const;
+		
+		/// <summary>
+		/// Center of each sphere on the X-axis.
+		/// </summary>
+		std::vector<float> _x;
+		/// <summary>
+		/// Center of each sphere on the Y-axis.
+		/// </summary>
+		std::vector<float> _y;
+		/// <summary>
+		/// Center of each sphere on the Z-axis.
+		/// </summary>
+		std::vector<float> _z;
+		/// <summary>
+		/// Radius of each sphere.
+		/// </summary>
+		std::vector<float> _radius;
+		/// <summary>
+		/// Sphere each entry was copied from, used to build surface fragments.
+		/// </summary>
+		std::vector<const tracesphere_t*> _sources;
+		
+	};
+	
+	/// <summary>
+	/// Contains methods and properties for a flat, structure of arrays copy of a list of axis-aligned cubes.
+	/// </summary>
+	struct cubearray_t
+	{
+		
+		inline cubearray_t() {}
+		inline ~cubearray_t() {}
+		
+		/// <summary>
+		/// Gets the number of cubes in the array.
+		/// </summary>
+		inline size_t size() const { return this->_sources.size(); }
+		
+		/// <summary>
+		/// Removes every cube from the array.
+		/// </summary>
+		void clear();
+		
+		/// <summary>
+		/// Appends a copy of the given cube to the array.
+		/// </summary>
+		/// <param name="cube">Cube to copy.</param>
+		void push_back(const traceaxiscube_t* cube);
+		
+		/// <summary>
+		/// Calculates the distance along the given ray to a single cube of the array, and which face of the cube it hits.
+		/// Faces are numbered 0, 1 and 2 for the lowest X, Y and Z sides, and 3, 4 and 5 for the highest.
+		/// </summary>
+		/// <param name="index">Index of the cube.</param>
+		/// <param name="ray">A ray to intersect with the cube.</param>
+		/// <param name="distance">Distance to the hit, only written if the ray hits the cube.</param>
+		/// <param name="face">Face that was hit, only written if the ray hits the cube.</param>
+		inline bool hitbyray(const size_t index, const ray_t& ray, float& distance, int& face) const
+		{
+			float a = 1.0f / ray._forward.x;
+			float b = 1.0f / ray._forward.y;
+			float c = 1.0f / ray._forward.z;
+			float tx0 = (this->_x0[index] - ray._origin.x) * a;
+			float tx1 = (this->_x1[index] - ray._origin.x) * a;
+			float ty0 = (this->_y0[index] - ray._origin.y) * b;
+			float ty1 = (this->_y1[index] - ray._origin.y) * b;
+			float tz0 = (this->_z0[index] - ray._origin.z) * c;
+			float tz1 = (this->_z1[index] - ray._origin.z) * c;
+			float nx = std::min(tx0, tx1);
+			float ny = std::min(ty0, ty1);
+			float nz = std::min(tz0, tz1);
+			float fx = std::max(tx0, tx1);
+			float fy = std::max(ty0, ty1);
+			float fz = std::max(tz0, tz1);
+			float t0 = std::max(std::max(nx, ny), nz);
+			float t1 = std::min(std::min(fx, fy), fz);
+			if (t0 < t1 && t1 > cubeepsilon)
+			{
+				if (t0 > cubeepsilon)
+				{
+					distance = t0;
+					face = t0 == nz ? (c >= 0.0f ? 2 : 5) : (t0 == ny ? (b >= 0.0f ? 1 : 4) : (a >= 0.0f ? 0 : 3));
+				}
+				else
+				{
+					distance = t1;
+					face = t1 == fz ? (c >= 0.0f ? 5 : 2) : (t1 == fy ? (b >= 0.0f ? 4 : 1) : (a >= 0.0f ? 3 : 0));
+				}
+				
+				return true;
+			}
+			
+			return false;
+		}
+		
+		/// <summary>
+		/// Finds the nearest cube in a range of the array hit by the given ray, testing as many cubes at once as the processor allows.
+		/// Every kernel uses the same slabs as hitbyray, so they all agree on the distance, the face and on ties.
+		/// </summary>
+		/// <param name="ray">A ray to intersect with the cubes.</param>
+		/// <param name="begin">Index of the first cube to test.</param>
+		/// <param name="end">One past the index of the last cube to test.</param>
+		/// <param name="distance">Only hits nearer than this are accepted, updated with the nearest hit.</param>
+		/// <param name="index">Index of the nearest cube, only written if one is hit.</param>
+		/// <param name="face">Face of the nearest cube that was hit, only written if one is hit.</param>
+		/// <returns>True if a cube nearer than the given distance is hit.</returns>
+		bool nearest(const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, int& face) const;
+		
+		/// <summary>
+		/// Calculates whether or not any cube in a range of the array is hit by the given ray before the given distance,
+		/// returning as soon as one is found.
+		/// </summary>
+		/// <param name="ray">A ray to intersect with the cubes.</param>
+		/// <param name="begin">Index of the first cube to test.</param>
+		/// <param name="end">One past the index of the last cube to test.</param>
+		/// <param name="distance">Only hits nearer than this are accepted.</param>
+		bool occluded(const ray_t& ray, const size_t begin, const size_t end, const float distance) const;
+		
+		/// <summary>
+		/// Lowest corner of each cube on the X-axis.
+		/// </summary>
+		std::vector<float> _x0;
+		/// <summary>
+		/// Lowest corner of each cube on the Y-axis.
+		/// </summary>
+		std::vector<float> _y0;
+		/// <summary>
+		/// Lowest corner of each cube on the Z-axis.
+		/// </summary>
+		std::vector<float> _z0;
+		/// <summary>
+		/// Highest corner of each cube on the X-axis.
+		/// </summary>
+		std::vector<float> _x1;
+		/// <summary>
+		/// Highest corner of each cube on the Y-axis.
+		/// </summary>
+		std::vector<float> _y1;
+		/// <summary>
+		/// Highest corner of each cube on the Z-axis.
+		/// </summary>
+		std::vector<float> _z1;
+		/// <summary>
+		/// Cube each entry was copied from, used to build surface fragments.
+		/// </summary>
+		std::vector<const traceaxiscube_t*> _sources;
+		
+	};
+
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RAYTRACER_SSE
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(RAYTRACER_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define RAYTRACER_AVX2 __attribute__((target("avx2")))
+#elif defined(RAYTRACER_SSE) && defined(_MSC_VER)
+#define RAYTRACER_AVX2
+#endif
+
+namespace ray
+{
+
+	/// <summary>
+	/// Enumeration for the instruction sets the intersection kernels can run on.
+	/// </summary>
+	enum SIMDTYPE
+	{
+		/// <summary>
+		/// Plain scalar code, one primitive at a time.
+		/// </summary>
+		SIMDTYPE_SCALAR,
+		/// <summary>
+		/// SSE, four primitives at a time.
+		/// </summary>
+		SIMDTYPE_SSE,
+		/// <summary>
+		/// AVX2, eight primitives at a time.
+		/// </summary>
+		SIMDTYPE_AVX2
+	};
+
+	/// <summary>
+	/// Gets the widest instruction set supported by both the build and the processor running it.
+	/// </summary>
+	SIMDTYPE simdsupport();
+
+	/// <summary>
+	/// Gets the instruction set the intersection kernels currently run on.
+	/// </summary>
+	SIMDTYPE simdlevel();
+
+	/// <summary>
+	/// Limits the instruction set the intersection kernels run on, clamped to what is supported.
+	/// </summary>
+	/// <param name="type">Widest instruction set to use.</param>
+	/// <returns>The instruction set that will be used.</returns>
+	SIMDTYPE simdlimit(const SIMDTYPE type);
+
+	/// <summary>
+	/// Gets the name of the given instruction set.
+	/// </summary>
+	const char* simdname(const SIMDTYPE type);
+
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+
+namespace ray
+{
+
+	/// <summary>
+	/// Contains properties for how a worker thread spent its time during a dispatch.
+	/// </summary>
+	struct workerstats_t
+	{
+
+		inline workerstats_t() :
+			_tasks(0),
+			_steals(0),
+			_busy(0.0) {}
+		inline ~workerstats_t() {}
+
+		/// <summary>
+		/// Gets the fraction of the given wall time that the worker spent running tasks.
+		/// </summary>
+		/// <param name="elapsed">Wall time of the dispatch in seconds.</param>
+		inline double utilization(const double elapsed) const { return elapsed > 0.0 ? this->_busy / elapsed : 0.0; }
+
+		/// <summary>
+		/// Number of tasks the worker ran.
+		/// </summary>
+		size_t _tasks;
+		/// <summary>
+		/// Number of the worker's tasks that were stolen from other workers.
+		/// </summary>
+		size_t _steals;
+		/// <summary>
+		/// Time in seconds the worker spent running tasks.
+		/// </summary>
+		double _busy;
+
+	};
+
+	/// <summary>
+	/// Contains methods and properties for a fixed pool of worker threads.
+	/// </summary>
+	class threadpool_t
+	{
+	public:
+
+		/// <summary>
+		/// Task that is run for a single index of a dispatch.
+		/// </summary>
+		typedef std::function<void(const size_t index, const size_t worker)> task_t;
+
+		/// <param name="threads">Number of worker threads, zero uses the hardware concurrency.</param>
+		threadpool_t(const size_t threads = 0);
+		~threadpool_t();
+
+		/// <summary>
+		/// Runs the given task once for every index below the count, blocking until all of them have finished.
+		/// Each worker is seeded with a contiguous run of the indices in its own deque, and steals from the
+		/// back of the other workers' deques once its own is empty.
+		/// </summary>
+		/// <param name="count">Number of indices to run the task for.</param>
+		/// <param name="task">Task to run, given the index and the worker running it.</param>
+		void dispatch(const size_t count, const task_t& task);
+
+		/// <summary>
+		/// Gets the number of worker threads in the pool.
+		/// </summary>
+		inline size_t size() const { return this->_workers.size(); }
+
+		/// <summary>
+		/// Gets how each worker spent its time during the last dispatch.
+		/// </summary>
+		inline const std::vector<workerstats_t>& stats() const { return this->_stats; }
+
+		/// <summary>
+		/// Gets the wall time in seconds of the last dispatch.
+		/// </summary>
+		inline double elapsed() const { return this->_elapsed; }
+
+		/// <summary>
+		/// Gets the number of threads the hardware can run concurrently.
+		/// </summary>
+		static size_t concurrency();
+
+	protected:
+
+		/// <summary>
+		/// Contains properties for the deque of indices owned by a single worker.
+		/// </summary>
+		struct workqueue_t
+		{
+			/// <summary>
+			/// Guards the indices, held by the owner and by thieves.
+			/// </summary>
+			std::mutex _mutex;
+			/// <summary>
+			/// Indices waiting to be run, the owner takes from the front and thieves from the back.
+			/// </summary>
+			std::deque<size_t> _indices;
+		};
+
+		/// <summary>
+		/// Takes the next index for the given worker, stealing from another worker if its own deque is empty.
+		/// </summary>
+		/// <param name="worker">Index of the worker.</param>
+		/// <param name="index">Index that has been taken.</param>
+		/// <param name="stolen">Whether or not the index was stolen.</param>
+		/// <returns>False if there are no indices left in any deque.</returns>
+		bool take(const size_t worker, size_t& index, bool& stolen);
+
+		/// <summary>
+		/// Main loop of a worker thread.
+		/// </summary>
+		/// <param name="worker">Index of the worker.</param>
+		void work(const size_t worker);
+
+		/// <summary>
+		/// Worker threads.
+		/// </summary>
+		std::vector<std::thread> _workers;
+		/// <summary>
+		/// Deque of indices for each worker.
+		/// </summary>
+		std::vector<workqueue_t> _queues;
+		/// <summary>
+		/// How each worker spent its time during the last dispatch.
+		/// </summary>
+		std::vector<workerstats_t> _stats;
+		/// <summary>
+		/// Wall time in seconds of the last dispatch.
+		/// </summary>
+		double _elapsed;
+		/// <summary>
+		/// Guards the dispatch state.
+		/// </summary>
+		std::mutex _mutex;
+		/// <summary>
+		/// Signalled when a dispatch starts or the pool is closing.
+		/// </summary>
+		std::condition_variable _wake;
+		/// <summary>
+		/// Signalled when the last worker finishes a dispatch.
+		/// </summary>
+		std::condition_variable _done;
+		/// <summary>
+		/// Task of the current dispatch.
+		/// </summary>
+		const task_t* _task;
+		/// <summary>
+		/// Incremented for every dispatch so sleeping workers can tell a new one has started.
+		/// </summary>
+		size_t _generation;
+		/// <summary>
+		/// Number of workers that have not finished the current dispatch.
+		/// </summary>
+		size_t _pending;
+		/// <summary>
+		/// Whether or not the workers should exit.
+		/// </summary>
+		bool _exit;
+
+	};
+
+}
\ No newline at end of file
@@ -37,6 +37,13 @@ namespace ray
 		/// <param name="v">Point on the viewport's y-axis.</param>
 		/// <returns>Ray going out from the focal point at the specified point on the viewport.</returns>
 		ray_t cast(const float u, const float v) const;
+		/// <summary>
+		/// Calculates a ray from the camera's viewport, along with its differentials.
+		/// </summary>
+		/// <param name="coord">2 dimensional vector representing a point of the viewport.</param>
+		/// <param name="pixel">Size of a single pixel on the viewport, in the same units as the point.</param>
+		/// <returns>Ray going out from the focal point at the specified point on the viewport.</returns>
+		ray_t cast(const glm::vec2& coord, const glm::vec2& pixel) const;
 		
 	protected:
 		
@@ -66,7 +73,8 @@ namespace ray
 	{
 	public:
 		
-		inline tracestack_t() {}
+		inline tracestack_t() :
+			_compiled(false) {}
 		inline ~tracestack_t() {}
 
 		/// <summary>
@@ -84,6 +92,142 @@ namespace ray
 		/// <returns>The farthest traceable object or null if no objects where hit.</returns>
 		const traceable_t* farthest(const ray_t& ray, rayhit_t* hit = 0) const;
 		
+		/// <summary>
+		/// Finds the nearest primitive of the compiled stack hit by the given ray, without building anything else about the hit.
+		/// The stack must have been built.
+		/// </summary>
+		/// <param name="ray">Ray to trace to intersect with the stack of traceable objects.</param>
+		/// <param name="record">Compact record of the nearest hit, only written if the ray hits something.</param>
+		/// <returns>True if the ray hits a primitive.</returns>
+		bool intersect(const ray_t& ray, hitrecord_t& record) const;
+		
+		/// <summary>
+		/// Finds the nearest primitive of the compiled stack hit by every ray of a group of coherent rays,
+		/// walking the hierarchy with packets of them at once. The stack must have been built.
+		/// </summary>
+		/// <param name="rays">Rays to trace.</param>
+		/// <param name="count">Number of rays.</param>
+		/// <param name="records">Compact record of the nearest hit of each ray, left empty for rays that hit nothing.</param>
+		void intersect(const ray_t* rays, const size_t count, hitrecord_t* records) const;
+		
+		/// <summary>
+		/// Rebuilds the full surface fragment of a hit found by intersect.
+		/// </summary>
+		/// <param name="ray">Ray that caused the hit.</param>
+		/// <param name="record">Compact record of the hit.</param>
+		/// <returns>Surface fragment at the hit.</returns>
+		fragment_t fragmentate(const ray_t& ray, const hitrecord_t& record) const;
+		
+		/// <summary>
+		/// Calculates whether or not any traceable object blocks the given ray before the given distance.
+		/// Stops at the first blocker found rather than searching for the nearest one, which is all a shadow ray needs.
+		/// </summary>
+		/// <param name="ray">Ray to trace to intersect with the stack of traceable objects.</param>
+		/// <param name="tmax">Distance along the ray past which objects do not block it.</param>
+		/// <returns>True if an object is hit before the distance.</returns>
+		bool occluded(const ray_t& ray, const float tmax) const;
+		
+		/// <summary>
+		/// Calculates how much of a light at the given point reaches the given surface fragment.
+		/// </summary>
+		/// <param name="fragment">Surface fragment being lit.</param>
+		/// <param name="point">Position of the light.</param>
+		/// <returns>One if nothing blocks the light, zero if the fragment is in shadow.</returns>
+		float visibility(const fragment_t& fragment, const glm::vec3& point) const;
+		
+		/// <summary>
+		/// Calculates how much of a light at the given point reaches each fragment of a batch,
+		/// walking the hierarchy with packets of the shadow rays at once.
+		/// </summary>
+		/// <param name="fragments">Surface fragments being lit.</param>
+		/// <param name="count">Number of fragments.</param>
+		/// <param name="point">Position of the light.</param>
+		/// <param name="occlusion">How much of the light reaches each fragment.</param>
+		/// <param name="packet">Number of shadow rays walked together, one or less traces them one at a time.</param>
+		void visibility(const fragment_t* fragments, const size_t count, const glm::vec3& point, float* occlusion, const size_t packet) const;
+		
+		/// <summary>
+		/// Calculates the lumination of every light on the given surface fragment.
+		/// </summary>
+		/// <param name="fragment">Surface fragment to illuminate.</param>
+		/// <returns>Lumination for the surface fragment.</returns>
+		lumination_t illuminate(const fragment_t& fragment) const;
+		
+		/// <summary>
+		/// Calculates the lumination of every light on a batch of fragments that share the same material,
+		/// adding it to each fragment's lumination. Each light is shaded over the whole batch at once.
+		/// </summary>
+		/// <param name="material">Material of every fragment of the batch.</param>
+		/// <param name="fragments">Fragments of the batch.</param>
+		/// <param name="count">Number of fragments in the batch.</param>
+		/// <param name="luminations">Lumination of each fragment of the batch.</param>
+		/// <param name="lighting">Buffer for the lighting of the fragments a single light reaches.</param>
+		/// <param name="indices">Buffer for the index of the fragments a single light reaches.</param>
+		/// <param name="batch">Buffer for the flat copy of the fragments that phong and blinn batches are shaded from.</param>
+		/// <param name="packet">Number of shadow rays walked together, one or less traces them one at a time.</param>
+		void illuminate(const material_t* material, const fragment_t* fragments, const size_t count, lumination_t* luminations, std::vector<lighting_t>& lighting, std::vector<uint32_t>& indices, fragmentarray_t& batch, const size_t packet) const;
+		
+		/// <summary>
+		/// Gets the material of a single primitive of the flat arrays.
+		/// </summary>
+		/// <param name="id">Primitive id of the shape.</param>
+		const material_t* material(const uint32_t id) const;
+		
+		/// <summary>
+		/// Compiles the lists of traceable objects and lights into flat arrays, and builds the acceleration structure over them.
+		/// Must be called again whenever either list changes, until then the lists are traced directly.
+		/// </summary>
+		/// <param name="type">Type of hierarchy to build, none tests every object of the flat arrays.</param>
+		void build(const BVHTYPE type);
+		/// <summary>
+		/// Compiles the lists of traceable objects and lights into flat arrays, and builds the acceleration structure over them on the given pool.
+		/// </summary>
+		/// <param name="type">Type of hierarchy to build, none tests every object of the flat arrays.</param>
+		/// <param name="pool">Thread pool to build the hierarchy on.</param>
+		void build(const BVHTYPE type, threadpool_t& pool);
+		
+		/// <summary>
+		/// Gets the hierarchy over the flat arrays, empty if it has not been built.
+		/// </summary>
+		inline const bvh_t& bvh() const { return this->_bvh; }
+		
+		/// <summary>
+		/// Calculates the distance along the given ray to a single primitive of the flat arrays.
+		/// </summary>
+		/// <param name="id">Primitive id of the shape.</param>
+		/// <param name="ray">A ray to intersect with the shape.</param>
+		/// <param name="distance">Distance to the hit, only written if the ray hits the shape.</param>
+		/// <param name="face">Face of the shape that was hit, negative for shapes without faces. Only written if the ray hits the shape.</param>
+		inline bool hitbyray(const uint32_t id, const ray_t& ray, float& distance, int& face) const
+		{
+			switch (primitivetype(id))
+			{
+			case SHAPETYPE_SPHERE:
+				face = -1;
+				return this->_spheres.hitbyray(primitiveindex(id), ray, distance);
+			case SHAPETYPE_AXISCUBE:
+				return this->_cubes.hitbyray(primitiveindex(id), ray, distance, face);
+			default:
+				return false;
+			}
+		}
+		
+		/// <summary>
+		/// Gets the traceable object a primitive of the flat arrays was copied from.
+		/// </summary>
+		/// <param name="id">Primitive id of the shape.</param>
+		const traceable_t* source(const uint32_t id) const;
+		
+		/// <summary>
+		/// Gets the flat array of spheres built from the traceable objects.
+		/// </summary>
+		inline const spherearray_t& spheres() const { return this->_spheres; }
+		
+		/// <summary>
+		/// Gets the flat array of cubes built from the traceable objects.
+		/// </summary>
+		inline const cubearray_t& cubes() const { return this->_cubes; }
+		
 		/// <summary>
 		/// List of traceable objects.
 		/// </summary>
@@ -93,10 +237,41 @@ namespace ray
 		/// </summary>
 		std::list<light_t*> _lights;
 		
+	protected:
+		
+		/// <summary>
+		/// Compiles the flat arrays and builds the acceleration structure, on the pool if there is one and on the calling thread otherwise.
+		/// </summary>
+		/// <param name="type">Type of hierarchy to build, none tests every object of the flat arrays.</param>
+		/// <param name="pool">Thread pool to build the hierarchy on, or null.</param>
+		void build(const BVHTYPE type, threadpool_t* pool);
+		
+		/// <summary>
+		/// Whether or not the lists have been compiled into the flat arrays.
+		/// </summary>
+		bool _compiled;
+		/// <summary>
+		/// Flat array of every sphere.
+		/// </summary>
+		spherearray_t _spheres;
+		/// <summary>
+		/// Flat array of every axis-aligned cube.
+		/// </summary>
+		cubearray_t _cubes;
+		/// <summary>
+		/// Flat array of every point light.
+		/// </summary>
+		pointlightarray_t _pointlights;
+		/// <summary>
+		/// Hierarchy over the flat arrays, its indices are primitive ids. Empty if it has not been built.
+		/// </summary>
+		bvh_t _bvh;
+		
 	};
 
 	/// <summary>
 	/// Contains methods and properties for a link in the path that a ray has taken as it hits surfaces.
+	/// Links do not own each other, every link of a path is held by the arena that allocated it.
 	/// </summary>
 	class tracepath_t
 	{
@@ -111,15 +286,22 @@ namespace ray
 			_stack((tracestack_t*)&stack),
 			_reflection(reflection),
 			_passthrough(passthrough) {}
-		inline ~tracepath_t() { this->clear(); }
+		inline ~tracepath_t() {}
 		
 		/// <summary>
-		/// Clears all linked path segments.
+		/// Unlinks all linked path segments, they are left to the arena that allocated them.
 		/// </summary>
 		void clear();
 		
 		/// <summary>
-		/// Calculates the lumination for the trace path.
+		/// Links the given segments to this segment of the path.
+		/// </summary>
+		/// <param name="reflection">Segment reflected off of this segment's fragment, or null.</param>
+		/// <param name="passthrough">Segment passed through from this segment's fragment, or null.</param>
+		void link(tracepath_t* reflection, tracepath_t* passthrough);
+		
+		/// <summary>
+		/// Calculates the lumination for the surface of this segment of the trace path, not including its links.
 		/// </summary>
 		/// <returns>Lumination value for the surface at this segment of the trace path.</returns>
 		lumination_t albedo() const;
@@ -127,7 +309,7 @@ namespace ray
 		/// <summary>
 		/// Gets the fragment for this segment of the path.
 		/// </summary>
-		const fragment_t fragment() const;
+		const fragment_t& fragment() const;
 
 		/// <summary>
 		/// Sets this path segment to the given fragment.
@@ -155,6 +337,275 @@ namespace ray
 
 	};
 	
+	/// <summary>
+	/// Contains properties for how a path arena has been used.
+	/// </summary>
+	struct arenastats_t
+	{
+		
+		inline arenastats_t() :
+			_nodes(0),
+			_chunks(0),
+			_peak(0),
+			_resets(0) {}
+		inline ~arenastats_t() {}
+		
+		/// <summary>
+		/// Number of path segments handed out.
+		/// </summary>
+		size_t _nodes;
+		/// <summary>
+		/// Number of chunks allocated from the heap, the only allocations the arena makes.
+		/// </summary>
+		size_t _chunks;
+		/// <summary>
+		/// Largest number of path segments handed out between two resets.
+		/// </summary>
+		size_t _peak;
+		/// <summary>
+		/// Number of times the arena has been reset.
+		/// </summary>
+		size_t _resets;
+		
+	};
+	
+	/// <summary>
+	/// Contains methods and properties for a bump allocator of path segments, used by a single thread.
+	/// Segments are handed out from fixed size chunks that are kept across resets, so once the arena
+	/// has grown to fit the largest set of paths between two resets it makes no more heap allocations.
+	/// </summary>
+	class patharena_t
+	{
+	public:
+		
+		/// <param name="chunkSize">Number of path segments in each chunk.</param>
+		inline patharena_t(const size_t chunkSize = 256) :
+			_chunk(0),
+			_used(0),
+			_chunkSize(chunkSize > 0 ? chunkSize : 256) {}
+		inline ~patharena_t() {}
+		
+		/// <summary>
+		/// Hands out a path segment for the given fragment, valid until the arena is reset.
+		/// </summary>
+		/// <param name="frag">Surface fragment of the segment.</param>
+		/// <param name="stack">Stack of objects that are involved in the traced scene.</param>
+		/// <returns>Path segment with no links.</returns>
+		tracepath_t* allocate(const fragment_t& frag, const tracestack_t& stack);
+		
+		/// <summary>
+		/// Takes back every path segment that has been handed out, keeping the chunks for reuse.
+		/// </summary>
+		void reset();
+		
+		/// <summary>
+		/// Gets how the arena has been used.
+		/// </summary>
+		inline const arenastats_t& stats() const { return this->_stats; }
+		
+	protected:
+		
+		/// <summary>
+		/// Chunks of path segments, each holding the chunk size.
+		/// </summary>
+		std::vector<std::vector<tracepath_t> > _chunks;
+		/// <summary>
+		/// Index of the chunk segments are being handed out from.
+		/// </summary>
+		size_t _chunk;
+		/// <summary>
+		/// Number of segments handed out from the current chunk.
+		/// </summary>
+		size_t _used;
+		/// <summary>
+		/// Number of path segments in each chunk.
+		/// </summary>
+		size_t _chunkSize;
+		/// <summary>
+		/// How the arena has been used.
+		/// </summary>
+		arenastats_t _stats;
+		
+	};
+	
+	/// <summary>
+	/// Contains methods and properties for a rectangular region of a photo.
+	/// </summary>
+	struct tile_t
+	{
+		
+		inline tile_t() :
+			_p0(0, 0),
+			_p1(0, 0) {}
+		/// <param name="p0">2 dimensional vector representing the first pixel of the tile.</param>
+		/// <param name="p1">2 dimensional vector representing one past the last pixel of the tile.</param>
+		inline tile_t(const glm::ivec2& p0, const glm::ivec2& p1) :
+			_p0(p0),
+			_p1(p1) {}
+		inline ~tile_t() {}
+		
+		/// <summary>
+		/// Gets the number of pixels covered by the tile.
+		/// </summary>
+		inline size_t area() const { return size_t(this->_p1.x - this->_p0.x) * size_t(this->_p1.y - this->_p0.y); }
+		
+		/// <summary>
+		/// First pixel of the tile.
+		/// </summary>
+		glm::ivec2 _p0;
+		/// <summary>
+		/// One past the last pixel of the tile.
+		/// </summary>
+		glm::ivec2 _p1;
+		
+	};
+	
+	/// <summary>
+	/// Contains methods and properties for the buffer of colors that a scene is traced into.
+	/// </summary>
+	class photo_t
+	{
+	public:
+		
+		inline photo_t() :
+			_width(0),
+			_height(0) {}
+		/// <param name="width">Width of the photo in pixels.</param>
+		/// <param name="height">Height of the photo in pixels.</param>
+		inline photo_t(const size_t width, const size_t height) :
+			_width(0),
+			_height(0) { this->resize(width, height); }
+		inline ~photo_t() {}
+		
+		/// <summary>
+		/// Gets a value indicating whether or not the photo has no pixels.
+		/// </summary>
+		bool empty() const;
+		
+		/// <summary>
+		/// Resizes the photo, clearing all of its pixels.
+		/// </summary>
+		/// <param name="width">Width of the photo in pixels.</param>
+		/// <param name="height">Height of the photo in pixels.</param>
+		void resize(const size_t width, const size_t height);
+		
+		/// <summary>
+		/// Splits the photo into tiles of the given size, the last row and column may be smaller.
+		/// </summary>
+		/// <param name="size">Width and height of each tile in pixels.</param>
+		/// <returns>List of tiles covering the whole photo.</returns>
+		std::vector<tile_t> tiles(const size_t size) const;
+		
+		/// <summary>
+		/// Converts the average of every pixel's samples into an 8-bit image.
+		/// </summary>
+		/// <returns>Image containing the photo, must be unloaded by the caller.</returns>
+		IMAGETYPE* rasterize() const;
+		
+		/// <summary>
+		/// Adds a sample to the pixel at the given coordinate.
+		/// </summary>
+		/// <param name="coord">Coordinate of the pixel.</param>
+		/// <param name="color">Color of the sample.</param>
+		void accumulate(const glm::ivec2& coord, const glm::vec4& color);
+		
+		/// <summary>
+		/// Gets the average of the samples of the pixel at the given coordinate, black if it has none yet.
+		/// </summary>
+		glm::vec4 color(const glm::ivec2& coord) const;
+		
+		/// <summary>
+		/// Gets the number of samples added to the pixel at the given coordinate.
+		/// </summary>
+		uint32_t samples(const glm::ivec2& coord) const;
+		
+		/// <summary>
+		/// Records the surface that the first sample of the pixel at the given coordinate hit.
+		/// </summary>
+		/// <param name="coord">Coordinate of the pixel.</param>
+		/// <param name="id">Primitive that was hit, or missid if the sample hit nothing.</param>
+		/// <param name="normal">Normal of the surface that was hit.</param>
+		void surface(const glm::ivec2& coord, const uint32_t id, const glm::vec3& normal);
+		
+		/// <summary>
+		/// Finds the pixels that sit on an edge, where the first sample of a pixel and of the pixel to its right or below it
+		/// hit different primitives, surfaces facing different ways, or have colors too far apart. Both pixels of such a pair are marked.
+		/// </summary>
+		/// <param name="facing">Smallest cosine between the normals of two pixels that are on the same surface.</param>
+		/// <param name="contrast">Largest difference in any channel between the colors of two pixels that are on the same surface.</param>
+		/// <returns>One for every pixel on an edge and zero for every other pixel, stored row by row.</returns>
+		std::vector<uint8_t> edges(const float facing, const float contrast) const;
+		
+		/// <summary>
+		/// Gets the half width of the 95% confidence interval of the mean luminance of the pixel at the given coordinate,
+		/// from the running variance of its samples. Pixels with fewer than two samples have the largest error.
+		/// </summary>
+		float error(const glm::ivec2& coord) const;
+		
+		/// <summary>
+		/// Finds the pixels that still need samples, because they have too few to trust their variance or their error is over the threshold.
+		/// </summary>
+		/// <param name="threshold">Largest error in luminance of a pixel that has converged.</param>
+		/// <param name="minimum">Fewest samples a pixel needs before it can converge.</param>
+		/// <returns>One for every pixel that still needs samples and zero for every other pixel, stored row by row.</returns>
+		std::vector<uint8_t> noisy(const float threshold, const uint32_t minimum) const;
+		
+		/// <summary>
+		/// Primitive recorded for pixels whose first sample hit nothing.
+		/// </summary>
+		static const uint32_t missid = 0xffffffffu;
+		
+		/// <summary>
+		/// Gets the width of the photo in pixels.
+		/// </summary>
+		inline size_t width() const { return this->_width; }
+		/// <summary>
+		/// Gets the height of the photo in pixels.
+		/// </summary>
+		inline size_t height() const { return this->_height; }
+		
+		/// <summary>
+		/// Gets the sum of the samples of the pixel at the given coordinate.
+		/// </summary>
+		glm::vec4& operator[](const glm::ivec2& coord);
+		/// <summary>
+		/// Gets the sum of the samples of the pixel at the given coordinate.
+		/// </summary>
+		const glm::vec4& operator[](const glm::ivec2& coord) const;
+		
+	protected:
+		
+		/// <summary>
+		/// Width of the photo in pixels.
+		/// </summary>
+		size_t _width;
+		/// <summary>
+		/// Height of the photo in pixels.
+		/// </summary>
+		size_t _height;
+		/// <summary>
+		/// Sum of the samples of every pixel in full float precision, stored row by row.
+		/// </summary>
+		std::vector<glm::vec4> _buffer;
+		/// <summary>
+		/// Number of samples of every pixel, stored row by row.
+		/// </summary>
+		std::vector<uint32_t> _counts;
+		/// <summary>
+		/// Sum of the squared luminance of the samples of every pixel, stored row by row.
+		/// </summary>
+		std::vector<float> _squares;
+		/// <summary>
+		/// Primitive the first sample of every pixel hit, stored row by row.
+		/// </summary>
+		std::vector<uint32_t> _ids;
+		/// <summary>
+		/// Normal of the surface the first sample of every pixel hit, stored row by row.
+		/// </summary>
+		std::vector<glm::vec3> _normals;
+		
+	};
+	
 	enum MULTISAMPLETYPE
 	{
 		MULTISAMPLETYPE_SINGLE = 0x0001,
@@ -166,6 +617,267 @@ namespace ray
 		MULTISAMPLETYPE_RANDOM = 0x0030
 	};
 	
+	/// <summary>
+	/// Enumeration for how the emitter shades the surfaces its rays hit.
+	/// </summary>
+	enum SHADINGTYPE
+	{
+		/// <summary>
+		/// Shade every pixel's hit as soon as it is found.
+		/// </summary>
+		SHADINGTYPE_FORWARD,
+		/// <summary>
+		/// Find the hits of a whole tile first, then shade them in batches of the same material.
+		/// </summary>
+		SHADINGTYPE_DEFERRED,
+		/// <summary>
+		/// Trace a whole tile's rays as a queue, one bounce at a time, shading each bounce's hits in batches of the same material.
+		/// </summary>
+		SHADINGTYPE_WAVEFRONT
+	};
+	
+	/// <summary>
+	/// Contains methods and properties for a queue of rays that are traced together, one flat array per property of the rays.
+	/// </summary>
+	struct rayqueue_t
+	{
+		
+		inline rayqueue_t() {}
+		inline ~rayqueue_t() {}
+		
+		/// <summary>
+		/// Gets the number of rays in the queue.
+		/// </summary>
+		inline size_t size() const
+		{
+			return this->_rays.size();
+		}
+		
+		/// <summary>
+		/// Empties the queue, keeping its memory.
+		/// </summary>
+		inline void clear()
+		{
+			this->_rays.clear();
+			this->_records.clear();
+			this->_pixels.clear();
+			this->_throughputs.clear();
+		}
+		
+		/// <summary>
+		/// Adds a ray to the end of the queue.
+		/// </summary>
+		/// <param name="ray">Ray to trace.</param>
+		/// <param name="pixel">Index of the pixel inside of the tile that the ray's path started from.</param>
+		/// <param name="throughput">Share of the lumination along the ray that reaches the pixel.</param>
+		inline void push_back(const ray_t& ray, const uint32_t pixel, const float throughput)
+		{
+			this->_rays.push_back(ray);
+			this->_pixels.push_back(pixel);
+			this->_throughputs.push_back(throughput);
+		}
+		
+		/// <summary>
+		/// Ray of every entry.
+		/// </summary>
+		std::vector<ray_t> _rays;
+		/// <summary>
+		/// Nearest hit of every entry's ray, once the queue has been intersected.
+		/// </summary>
+		std::vector<hitrecord_t> _records;
+		/// <summary>
+		/// Index of the pixel inside of the tile that every entry's path started from.
+		/// </summary>
+		std::vector<uint32_t> _pixels;
+		/// <summary>
+		/// Throughput of every entry's path.
+		/// </summary>
+		std::vector<float> _throughputs;
+		
+	};
+	
+	/// <summary>
+	/// Contains properties for the buffers a thread reuses to shade tiles in deferred and wavefront mode.
+	/// </summary>
+	struct gbuffer_t
+	{
+		
+		/// <summary>
+		/// Contains properties for a single pixel's hit, ordered by material so each material's hits are shaded together,
+		/// then by shape and pixel so neighbouring hits stay next to each other for the shadow ray packets.
+		/// </summary>
+		struct entry_t
+		{
+			inline bool operator<(const entry_t& other) const
+			{
+				if (this->_material != other._material)
+				{
+					return this->_material < other._material;
+				}
+				
+				return this->_record._id != other._record._id ? this->_record._id < other._record._id : this->_pixel < other._pixel;
+			}
+			
+			/// <summary>
+			/// Material of the shape that was hit.
+			/// </summary>
+			const material_t* _material;
+			/// <summary>
+			/// Index of the pixel inside of the tile, or of the ray in the queue in wavefront mode.
+			/// </summary>
+			uint32_t _pixel;
+			/// <summary>
+			/// Compact record of the hit.
+			/// </summary>
+			hitrecord_t _record;
+		};
+		
+		inline gbuffer_t() {}
+		inline ~gbuffer_t() {}
+		
+		/// <summary>
+		/// Camera ray of every pixel of the tile.
+		/// </summary>
+		std::vector<ray_t> _rays;
+		/// <summary>
+		/// Hit of every pixel whose ray hit something.
+		/// </summary>
+		std::vector<entry_t> _entries;
+		/// <summary>
+		/// Fragment of every hit, in the same order as the entries.
+		/// </summary>
+		std::vector<fragment_t> _fragments;
+		/// <summary>
+		/// Lumination of every hit, in the same order as the entries.
+		/// </summary>
+		std::vector<lumination_t> _luminations;
+		/// <summary>
+		/// Lighting of the fragments a single light reaches, used while shading a batch.
+		/// </summary>
+		std::vector<lighting_t> _lighting;
+		/// <summary>
+		/// Index of the fragments a single light reaches, used while shading a batch.
+		/// </summary>
+		std::vector<uint32_t> _indices;
+		/// <summary>
+		/// Flat copy of the fragments of a phong or blinn batch, used while shading it.
+		/// </summary>
+		fragmentarray_t _batch;
+		/// <summary>
+		/// Rays of the bounce being traced in wavefront mode.
+		/// </summary>
+		rayqueue_t _queue;
+		/// <summary>
+		/// Rays of the next bounce, gathered while the current one is shaded in wavefront mode.
+		/// </summary>
+		rayqueue_t _next;
+		/// <summary>
+		/// Lumination gathered so far by every pixel of the tile in wavefront mode.
+		/// </summary>
+		std::vector<lumination_t> _gathered;
+		
+	};
+	
+	/// <summary>
+	/// Contains methods and properties for the random numbers of a single sample of a pixel, drawn from a scrambled (0,2)-sequence.
+	/// The first two dimensions of the Sobol sequence are a (0,2)-sequence, so every run of samples that is a power of two long
+	/// and starts at a multiple of its length covers the unit square evenly. Each pixel and frame owen scrambles the sequence
+	/// and shuffles its order by a hash of their own, and each pair of dimensions by another, so neighbouring pixels and
+	/// dimensions do not line up with each other. The numbers depend on nothing but the pixel, sample and frame, so a photo
+	/// comes out the same however its tiles are spread over threads or machines.
+	/// </summary>
+	struct sampler_t
+	{
+		
+		/// <param name="pixel">Index of the pixel in the photo.</param>
+		/// <param name="sample">Index of the sample of the pixel.</param>
+		/// <param name="frame">Index of the frame being traced.</param>
+		inline sampler_t(const uint32_t pixel, const uint32_t sample, const uint32_t frame) :
+			_seed(hash(pixel ^ hash(frame ^ 0x9e3779b9u))),
+			_sample(sample) {}
+		inline ~sampler_t() {}
+		
+		/// <summary>
+		/// Gets the point of the sample in the given pair of dimensions, each between zero and one.
+		/// </summary>
+		/// <param name="dimension">Index of the pair of dimensions.</param>
+		glm::vec2 get(const uint32_t dimension) const;
+		
+		/// <summary>
+		/// Mixes the bits of the given value into a new well spread value.
+		/// </summary>
+		static inline uint32_t hash(uint32_t x)
+		{
+			x ^= x >> 16;
+			x *= 0x7feb352du;
+			x ^= x >> 15;
+			x *= 0x846ca68bu;
+			x ^= x >> 16;
+			return x;
+		}
+		
+		/// <summary>
+		/// Seed of the pixel and frame.
+		/// </summary>
+		uint32_t _seed;
+		/// <summary>
+		/// Index of the sample in the sequence.
+		/// </summary>
+		uint32_t _sample;
+		
+	};
+	
+	/// <summary>
+	/// Contains methods and properties for how long a progressive render goes on for, and how often it shows its progress.
+	/// </summary>
+	struct progress_t
+	{
+		
+		inline progress_t() :
+			_samples(1),
+			_seconds(0.0),
+			_interval(0.0),
+			_threshold(0.0f) {}
+		/// <param name="samples">Most samples to trace per pixel, zero for no limit. Zero traces a single sample when neither a time budget nor a threshold stops it.</param>
+		/// <param name="seconds">Most wall time in seconds to trace for, zero for no limit. A pass that has started is always finished.</param>
+		/// <param name="interval">Least wall time in seconds between previews of the photo, zero for none.</param>
+		/// <param name="threshold">Error in luminance under which a pixel stops getting samples, zero samples every pixel in every pass.</param>
+		inline progress_t(const size_t samples, const double seconds, const double interval, const float threshold = 0.0f) :
+			_samples(samples == 0 && seconds <= 0.0 && threshold <= 0.0f ? 1 : samples),
+			_seconds(std::max(seconds, 0.0)),
+			_interval(std::max(interval, 0.0)),
+			_threshold(std::max(threshold, 0.0f)) {}
+		inline ~progress_t() {}
+		
+		/// <summary>
+		/// Gets a value indicating whether or not another pass should be traced.
+		/// </summary>
+		/// <param name="samples">Number of samples per pixel traced so far.</param>
+		/// <param name="elapsed">Wall time in seconds spent tracing so far.</param>
+		inline bool more(const size_t samples, const double elapsed) const
+		{
+			return (this->_samples == 0 || samples < this->_samples) && (this->_seconds <= 0.0 || elapsed < this->_seconds);
+		}
+		
+		/// <summary>
+		/// Most samples to trace per pixel, zero for no limit.
+		/// </summary>
+		size_t _samples;
+		/// <summary>
+		/// Most wall time in seconds to trace for, zero for no limit.
+		/// </summary>
+		double _seconds;
+		/// <summary>
+		/// Least wall time in seconds between previews of the photo, zero for none.
+		/// </summary>
+		double _interval;
+		/// <summary>
+		/// Error in luminance under which a pixel stops getting samples, zero for none.
+		/// </summary>
+		float _threshold;
+		
+	};
+	
 	/// <summary>
 	/// Contains methods and properties of an emitter that traces rays.
 	/// </summary>
@@ -173,20 +885,242 @@ namespace ray
 	{
 	public:
 		
+		/// <summary>
+		/// Largest width and height in pixels of a packet of camera rays.
+		/// </summary>
+		static const size_t maxpacket = 8;
+		
+		/// <summary>
+		/// Function that is shown the photo between passes, given the number of samples per pixel traced so far.
+		/// </summary>
+		typedef std::function<void(const photo_t& photo, const size_t samples)> preview_t;
+		
 		inline emitter_t() :
 			_reflectDepth(0),
-			_multiSample(MULTISAMPLETYPE_SINGLE | MULTISAMPLETYPE_EDGE) {}
+			_multiSample(MULTISAMPLETYPE_SINGLE | MULTISAMPLETYPE_EDGE),
+			_threads(0),
+			_tileSize(32),
+			_shading(SHADINGTYPE_FORWARD),
+			_packetSize(8),
+			_progress(),
+			_frame(0) {}
 		/// <param name="reflectDepth">Reflection depth of the photo.</param>
 		/// <param name="multiSampleRate">Multi sample rate of the photo.</param>
-		inline emitter_t(const size_t reflectDepth, const int multiSample) :
+		/// <param name="threads">Number of threads to trace with, zero uses the hardware concurrency.</param>
+		/// <param name="tileSize">Width and height in pixels of the tiles handed to each thread.</param>
+		/// <param name="shading">How the surfaces that rays hit are shaded.</param>
+		/// <param name="packetSize">Width and height in pixels of the packets camera rays are traced in, one or less traces them one at a time.</param>
+		/// <param name="progress">How many passes to trace, and how often to preview the photo between them.</param>
+		/// <param name="frame">Index of the frame being traced, which every sample's random numbers are seeded with.</param>
+		inline emitter_t(const size_t reflectDepth, const int multiSample, const size_t threads = 0, const size_t tileSize = 32, const SHADINGTYPE shading = SHADINGTYPE_FORWARD, const size_t packetSize = 8, const progress_t& progress = progress_t(), const uint32_t frame = 0) :
 			_reflectDepth(reflectDepth),
-			_multiSample(multiSample) {}
+			_multiSample(multiSample),
+			_threads(threads),
+			_tileSize(tileSize > 0 ? tileSize : 32),
+			_shading(shading),
+			_packetSize(std::min(std::max(packetSize, size_t(1)), maxpacket)),
+			_progress(progress),
+			_frame(frame) {}
 		inline ~emitter_t() {}
 		
-		void emit(const scene_t& scene, tracepath_t& path);
+		/// <summary>
+		/// Traces the scene into the given photo, resizing it to the scene's photo resolution.
+		/// The photo is traced in passes that each add one sample to every pixel, until the sample count or time budget is reached.
+		/// Passes past the sample count that are still within the multisample count add samples to the pixels on an edge only,
+		/// found from the first pass, or to every pixel if the multisample mode isn't edge.
+		/// With a convergence threshold, once every pixel has 8 samples and so after any edge passes, pixels whose error falls under it stop getting samples, tiles without any noisy pixels
+		/// are skipped, and tracing stops early once every pixel has converged.
+		/// </summary>
+		/// <param name="scene">Scene to trace.</param>
+		/// <param name="photo">Photo to trace into.</param>
+		/// <param name="preview">Function shown the photo between passes, at most once per preview interval.</param>
+		void emit(const scene_t& scene, photo_t& photo, const preview_t& preview = preview_t()) const;
+		
+		/// <summary>
+		/// Gets a value indicating whether or not camera samples are spread over their pixel, which they are whenever more than one sample per pixel may be traced.
+		/// A photo of a single sample per pixel keeps every sample at the center of its pixel.
+		/// </summary>
+		inline bool jittered() const { return this->_progress._samples != 1 || this->_progress._seconds > 0.0 || this->multisample() > 1; }
+		
+		/// <summary>
+		/// Gets the number of samples per pixel of the multisample type, which pixels on an edge get when sampling adaptively.
+		/// </summary>
+		inline size_t multisample() const
+		{
+			switch (this->_multiSample & 0x000f)
+			{
+			case MULTISAMPLETYPE_QUAD:
+				return 4;
+			case MULTISAMPLETYPE_OCT:
+				return 8;
+			default:
+				return 1;
+			}
+		}
 		
 	protected:
 		
+		/// <summary>
+		/// Contains properties for the state of a path as it is followed through the scene.
+		/// </summary>
+		struct pathstate_t
+		{
+			/// <param name="sampler">Random numbers for the choices along the path, unique to the pixel and sample.</param>
+			inline pathstate_t(const sampler_t& sampler) :
+				_lumination(0.0f, 0.0f),
+				_throughput(1.0f),
+				_depth(0),
+				_previous(0),
+				_reflected(false),
+				_sampler(sampler) {}
+			
+			/// <summary>
+			/// Lumination gathered along the path so far.
+			/// </summary>
+			lumination_t _lumination;
+			/// <summary>
+			/// Share of the next surface's lumination that reaches the start of the path.
+			/// </summary>
+			float _throughput;
+			/// <summary>
+			/// Number of surfaces the path has hit.
+			/// </summary>
+			size_t _depth;
+			/// <summary>
+			/// Last link of the path, or null if the path has not hit anything yet.
+			/// </summary>
+			tracepath_t* _previous;
+			/// <summary>
+			/// Whether or not the path reflected off of the last link, rather than passing through it.
+			/// </summary>
+			bool _reflected;
+			/// <summary>
+			/// Random numbers for the choices along the path.
+			/// </summary>
+			sampler_t _sampler;
+		};
+		
+		/// <summary>
+		/// Traces every pixel of a single tile of the photo, shading each hit as soon as it is found.
+		/// </summary>
+		/// <param name="scene">Scene to trace.</param>
+		/// <param name="tile">Region of the photo to trace.</param>
+		/// <param name="photo">Photo to trace into.</param>
+		/// <param name="arena">Arena of the thread tracing the tile, reset before the tile is traced.</param>
+		/// <param name="sample">Index of the pass, and so of the sample added to every pixel.</param>
+		/// <param name="active">One for every pixel of the photo to add a sample to and zero for the others, or null to add one to every pixel.</param>
+		void trace(const scene_t& scene, const tile_t& tile, photo_t& photo, patharena_t& arena, const size_t sample, const uint8_t* active) const;
+		
+		/// <summary>
+		/// Traces every pixel of a single tile of the photo, finding every camera hit first and then shading them
+		/// in batches of the same material. Paths that go on past their first surface are followed afterwards.
+		/// </summary>
+		/// <param name="scene">Scene to trace.</param>
+		/// <param name="tile">Region of the photo to trace.</param>
+		/// <param name="photo">Photo to trace into.</param>
+		/// <param name="arena">Arena of the thread tracing the tile, reset before the tile is traced.</param>
+		/// <param name="gbuffer">Buffers of the thread tracing the tile.</param>
+		/// <param name="sample">Index of the pass, and so of the sample added to every pixel.</param>
+		/// <param name="active">One for every pixel of the photo to add a sample to and zero for the others, or null to add one to every pixel.</param>
+		void defer(const scene_t& scene, const tile_t& tile, photo_t& photo, patharena_t& arena, gbuffer_t& gbuffer, const size_t sample, const uint8_t* active) const;
+		
+		/// <summary>
+		/// Traces every pixel of a single tile of the photo as a stream of ray queues, one bounce at a time.
+		/// Each bounce intersects its whole queue, drops the rays that missed, shades the hits in batches of the same material,
+		/// and queues the rays that the surviving paths go on with for the next bounce.
+		/// </summary>
+		/// <param name="scene">Scene to trace.</param>
+		/// <param name="tile">Region of the photo to trace.</param>
+		/// <param name="photo">Photo to trace into.</param>
+		/// <param name="gbuffer">Buffers of the thread tracing the tile.</param>
+		/// <param name="sample">Index of the pass, and so of the sample added to every pixel.</param>
+		/// <param name="active">One for every pixel of the photo to add a sample to and zero for the others, or null to add one to every pixel.</param>
+		void stream(const scene_t& scene, const tile_t& tile, photo_t& photo, gbuffer_t& gbuffer, const size_t sample, const uint8_t* active) const;
+		
+		/// <summary>
+		/// Rebuilds the fragments of the hits in a gbuffer in material order, and shades them in batches of the same material.
+		/// </summary>
+		/// <param name="scene">Scene to trace.</param>
+		/// <param name="rays">Rays that the entries of the gbuffer index into.</param>
+		/// <param name="gbuffer">Buffers holding the entries to shade, sorted and filled with their fragments and luminations.</param>
+		void shade(const scene_t& scene, const ray_t* rays, gbuffer_t& gbuffer) const;
+		
+		/// <summary>
+		/// Gets the random numbers of a single sample of a pixel in the frame being traced.
+		/// </summary>
+		/// <param name="photo">Photo being traced.</param>
+		/// <param name="pixel">Coordinate of the pixel.</param>
+		/// <param name="sample">Index of the sample.</param>
+		sampler_t sampler(const photo_t& photo, const glm::ivec2& pixel, const size_t sample) const;
+		
+		/// <summary>
+		/// Casts the camera ray of a single sample of a pixel.
+		/// </summary>
+		/// <param name="scene">Scene to trace.</param>
+		/// <param name="photo">Photo being traced.</param>
+		/// <param name="pixel">Coordinate of the pixel.</param>
+		/// <param name="sample">Index of the sample.</param>
+		ray_t cast(const scene_t& scene, const photo_t& photo, const glm::ivec2& pixel, const size_t sample) const;
+		
+		/// <summary>
+		/// Casts the camera ray of every active pixel of a block of the photo and finds their nearest hits,
+		/// as a single packet if there is more than one of them.
+		/// </summary>
+		/// <param name="scene">Scene to trace.</param>
+		/// <param name="block">Region of the photo to cast rays for, no larger than a packet.</param>
+		/// <param name="photo">Photo being traced.</param>
+		/// <param name="sample">Index of the sample to cast for every pixel.</param>
+		/// <param name="active">One for every pixel of the photo to cast a ray for and zero for the others, or null to cast one for every pixel.</param>
+		/// <param name="rays">Camera ray of each active pixel of the block, row by row.</param>
+		/// <param name="records">Nearest hit of each ray, empty if the ray hits nothing.</param>
+		/// <param name="pixels">Coordinate of each active pixel of the block.</param>
+		/// <returns>Number of rays cast.</returns>
+		size_t cast(const scene_t& scene, const tile_t& block, const photo_t& photo, const size_t sample, const uint8_t* active, ray_t* rays, hitrecord_t* records, glm::ivec2* pixels) const;
+		
+		/// <summary>
+		/// Traces a single ray through the scene from its already found first hit, following reflections and passthroughs iteratively.
+		/// </summary>
+		/// <param name="scene">Scene to trace.</param>
+		/// <param name="ray">Ray to trace.</param>
+		/// <param name="record">Nearest hit of the ray, empty if it hits nothing.</param>
+		/// <param name="arena">Arena to allocate the segments of the path from.</param>
+		/// <param name="sampler">Random numbers for the choices along the path, unique to the pixel and sample.</param>
+		/// <param name="normal">Normal of the first surface the ray hits, left as is if it hits nothing.</param>
+		/// <returns>4 dimensional vector representing the color seen along the ray.</returns>
+		glm::vec4 trace(const scene_t& scene, const ray_t& ray, const hitrecord_t& record, patharena_t& arena, const sampler_t& sampler, glm::vec3& normal) const;
+		
+		/// <summary>
+		/// Follows a path from the given ray until it stops hitting surfaces or scatter ends it.
+		/// </summary>
+		/// <param name="scene">Scene to trace.</param>
+		/// <param name="ray">Next ray of the path.</param>
+		/// <param name="arena">Arena to allocate the segments of the path from.</param>
+		/// <param name="state">State of the path.</param>
+		void follow(const scene_t& scene, ray_t ray, patharena_t& arena, pathstate_t& state) const;
+		
+		/// <summary>
+		/// Adds a shaded surface to a path and picks the ray the path goes on with.
+		/// Each surface scales the throughput of the path by its reflectivity plus transparency, once the throughput
+		/// drops below the roulette threshold the path continues with a probability matching it and is weighted up to
+		/// make up for the paths that stopped. Paths never go further than the reflection depth.
+		/// </summary>
+		/// <param name="path">Link of the path at the surface.</param>
+		/// <param name="lumination">Lumination of the surface.</param>
+		/// <param name="state">State of the path.</param>
+		/// <param name="ray">Ray that hit the surface, replaced by the ray the path goes on with.</param>
+		/// <returns>False if the path ends at the surface.</returns>
+		bool scatter(tracepath_t* path, const lumination_t& lumination, pathstate_t& state, ray_t& ray) const;
+		
+		/// <summary>
+		/// Adds a shaded surface to a path and picks the ray the path goes on with, without linking the surface into a chain of path segments.
+		/// </summary>
+		/// <param name="fragment">Fragment of the surface.</param>
+		/// <param name="lumination">Lumination of the surface.</param>
+		/// <param name="state">State of the path.</param>
+		/// <param name="ray">Ray that hit the surface, replaced by the ray the path goes on with.</param>
+		/// <returns>False if the path ends at the surface.</returns>
+		bool scatter(const fragment_t& fragment, const lumination_t& lumination, pathstate_t& state, ray_t& ray) const;
+		
 		/// <summary>
 		/// How many times to reflect off of a traced surface.
 		/// </summary>
@@ -195,6 +1129,31 @@ namespace ray
 		/// How many ray to trace per pixel on a axis.
 		/// </summary>
 		int _multiSample;
+		/// <summary>
+		/// Number of threads to trace with, zero uses the hardware concurrency.
+		/// </summary>
+		size_t _threads;
+		/// <summary>
+		/// Width and height in pixels of the tiles handed to each thread.
+		/// </summary>
+		size_t _tileSize;
+		/// <summary>
+		/// How the surfaces that rays hit are shaded.
+		/// </summary>
+		SHADINGTYPE _shading;
+		/// <summary>
+		/// Width and height in pixels of the packets camera rays are traced in, one traces them one at a time.
+		/// Shadow rays of deferred batches are traced in packets of its square.
+		/// </summary>
+		size_t _packetSize;
+		/// <summary>
+		/// How many passes to trace, and how often to preview the photo between them.
+		/// </summary>
+		progress_t _progress;
+		/// <summary>
+		/// Index of the frame being traced, which every sample's random numbers are seeded with.
+		/// </summary>
+		uint32_t _frame;
 		
 	};
 
@@ -3,6 +3,69 @@
 namespace ray
 {
 	
+	/// <summary>
+	/// Contains methods and properties for the differentials of a ray.
+	/// Differentials are how far the origin and direction of a ray move when stepping one pixel over on the viewport.
+	/// </summary>
+	struct raydifferential_t
+	{
+		
+		inline raydifferential_t() :
+			_dodx(0.0f),
+			_dody(0.0f),
+			_dddx(0.0f),
+			_dddy(0.0f) {}
+		/// <param name="dodx">Change in origin one pixel over on the X-axis.</param>
+		/// <param name="dody">Change in origin one pixel over on the Y-axis.</param>
+		/// <param name="dddx">Change in direction one pixel over on the X-axis.</param>
+		/// <param name="dddy">Change in direction one pixel over on the Y-axis.</param>
+		inline raydifferential_t(const glm::vec3& dodx, const glm::vec3& dody, const glm::vec3& dddx, const glm::vec3& dddy) :
+			_dodx(dodx),
+			_dody(dody),
+			_dddx(dddx),
+			_dddy(dddy) {}
+		inline ~raydifferential_t() {}
+		
+		/// <summary>
+		/// Carries the differentials along the ray to a hit on a surface, and calculates how far the hit moves one pixel over.
+		/// </summary>
+		/// <param name="forward">Direction of the ray.</param>
+		/// <param name="distance">Distance along the ray to the hit.</param>
+		/// <param name="normal">Surface normal at the hit.</param>
+		/// <param name="dpdx">Change in the hit position one pixel over on the X-axis.</param>
+		/// <param name="dpdy">Change in the hit position one pixel over on the Y-axis.</param>
+		inline void transfer(const glm::vec3& forward, const float distance, const glm::vec3& normal, glm::vec3& dpdx, glm::vec3& dpdy) const
+		{
+			dpdx = this->_dodx + (this->_dddx * distance);
+			dpdy = this->_dody + (this->_dddy * distance);
+			float facing = glm::dot(forward, normal);
+			if (facing != 0.0f)
+			{
+				// Slides the moved points along the ray until they are back on the plane of the surface.
+				dpdx -= forward * (glm::dot(dpdx, normal) / facing);
+				dpdy -= forward * (glm::dot(dpdy, normal) / facing);
+			}
+		}
+		
+		/// <summary>
+		/// Change in origin one pixel over on the X-axis.
+		/// </summary>
+		glm::vec3 _dodx;
+		/// <summary>
+		/// Change in origin one pixel over on the Y-axis.
+		/// </summary>
+		glm::vec3 _dody;
+		/// <summary>
+		/// Change in direction one pixel over on the X-axis.
+		/// </summary>
+		glm::vec3 _dddx;
+		/// <summary>
+		/// Change in direction one pixel over on the Y-axis.
+		/// </summary>
+		glm::vec3 _dddy;
+		
+	};
+	
 	/// <summary>
 	/// Contains methods and properties for a ray datatype.
 	/// Rays have an origin point and a directional vector.
@@ -23,6 +86,13 @@ namespace ray
 		inline ray_t(const glm::vec4& origin, const glm::vec3& forward) :
 			_origin(origin),
 			_forward(forward) {}
+		/// <param name="origin">3 dimensional vector representing the origin of the ray.</param>
+		/// <param name="origin">3 dimensional vector representing the direction of the ray.</param>
+		/// <param name="differential">Differentials of the ray.</param>
+		inline ray_t(const glm::vec3& origin, const glm::vec3& forward, const raydifferential_t& differential) :
+			_origin(origin, 1.0f),
+			_forward(forward),
+			_differential(differential) {}
 		inline ~ray_t() {}
 		
 		inline ray_t operator+() const
@@ -132,6 +202,10 @@ namespace ray
 		/// Forward directional vector of the ray.
 		/// </summary>
 		glm::vec3 _forward;
+		/// <summary>
+		/// Differentials of the ray, all zero for rays that do not come from the camera.
+		/// </summary>
+		raydifferential_t _differential;
 		
 	};
 	
@@ -577,6 +651,140 @@ namespace ray
 	    return lumination_t(v / l._diffuse, v / l._specular);
 	}
 	
+	/// <summary>
+	/// Contains methods and properties for an axis-aligned bounding box.
+	/// </summary>
+	struct bounds_t
+	{
+		
+		inline bounds_t() :
+			_min(FLT_MAX, FLT_MAX, FLT_MAX),
+			_max(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+		/// <param name="min">3 dimensional vector representing the most minimum corner of the box.</param>
+		/// <param name="max">3 dimensional vector representing the most maximum corner of the box.</param>
+		inline bounds_t(const glm::vec3& min, const glm::vec3& max) :
+			_min(min),
+			_max(max) {}
+		inline ~bounds_t() {}
+		
+		/// <summary>
+		/// Gets a value indicating whether or not the box contains nothing.
+		/// </summary>
+		inline bool empty() const { return this->_min.x > this->_max.x || this->_min.y > this->_max.y || this->_min.z > this->_max.z; }
+		
+		/// <summary>
+		/// Grows the box to contain the given point.
+		/// </summary>
+		inline void expand(const glm::vec3& point)
+		{
+			this->_min = glm::min(this->_min, point);
+			this->_max = glm::max(this->_max, point);
+		}
+		/// <summary>
+		/// Grows the box to contain the given box.
+		/// </summary>
+		inline void expand(const bounds_t& other)
+		{
+			this->_min = glm::min(this->_min, other._min);
+			this->_max = glm::max(this->_max, other._max);
+		}
+		
+		/// <summary>
+		/// Gets the center point of the box.
+		/// </summary>
+		inline glm::vec3 center() const { return (this->_min + this->_max) * 0.5f; }
+		
+		/// <summary>
+		/// Gets the surface area of the box, or zero if it is empty.
+		/// </summary>
+		inline float area() const
+		{
+			if (this->empty())
+			{
+				return 0.0f;
+			}
+			
+			glm::vec3 size = this->_max - this->_min;
+			return 2.0f * ((size.x * size.y) + (size.y * size.z) + (size.z * size.x));
+		}
+		
+		/// <summary>
+		/// Gets the axis the box is longest on.
+		/// </summary>
+		inline int axis() const
+		{
+			glm::vec3 size = this->_max - this->_min;
+			return size.x > size.y && size.x > size.z ? 0 : (size.y > size.z ? 1 : 2);
+		}
+		
+		/// <summary>
+		/// Calculates whether or not the given ray passes through the box before the given distance.
+		/// </summary>
+		/// <param name="origin">Origin of the ray.</param>
+		/// <param name="inverse">Reciprocal of each component of the ray's direction.</param>
+		/// <param name="distance">Farthest distance along the ray to accept.</param>
+		inline bool hitbyray(const glm::vec3& origin, const glm::vec3& inverse, const float distance) const
+		{
+			glm::vec3 t0 = (this->_min - origin) * inverse;
+			glm::vec3 t1 = (this->_max - origin) * inverse;
+			glm::vec3 tmin = glm::min(t0, t1);
+			glm::vec3 tmax = glm::max(t0, t1);
+			float enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+			float exit = std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, distance));
+			return enter <= exit;
+		}
+		
+		/// <summary>
+		/// Most minimum corner of the box.
+		/// </summary>
+		glm::vec3 _min;
+		/// <summary>
+		/// Most maximum corner of the box.
+		/// </summary>
+		glm::vec3 _max;
+		
+	};
+	
+	/// <summary>
+	/// Contains properties for the compact result of tracing a ray through a compiled stack.
+	/// Holds only what is needed to find the hit again, the full fragment is rebuilt from it once the hit is shaded.
+	/// </summary>
+	struct hitrecord_t
+	{
+		
+		inline hitrecord_t() :
+			_id(0),
+			_distance(-1.0f),
+			_face(-1) {}
+		/// <param name="id">Primitive id of the shape that was hit.</param>
+		/// <param name="distance">Distance from the ray origin to the intersection.</param>
+		/// <param name="face">Index of the face of the shape that was hit, negative if the shape has no faces.</param>
+		inline hitrecord_t(const uint32_t id, const float distance, const int32_t face = -1) :
+			_id(id),
+			_distance(distance),
+			_face(face) {}
+		inline ~hitrecord_t() {}
+		
+		/// <summary>
+		/// Gets a value indicating whether or not the record is empty.
+		/// </summary>
+		inline bool empty() const { return this->_distance < 0.0f; }
+		
+		/// <summary>
+		/// Primitive id of the shape that was hit.
+		/// </summary>
+		uint32_t _id;
+		/// <summary>
+		/// Distance from the ray origin to the intersection.
+		/// </summary>
+		float _distance;
+		/// <summary>
+		/// Index of the face of the shape that was hit, negative if the shape has no faces.
+		/// </summary>
+		int32_t _face;
+		
+	};
+	
 	/// <summary>
 	/// Contains methods and properties for the result of a ray hitting a shape.
 	/// </summary>
@@ -585,7 +793,8 @@ namespace ray
 		
 		inline rayhit_t() :
 			_distance(-1.0f),
-			_intersection(0.0f, 0.0f, 0.0f, 1.0) {}
+			_intersection(0.0f, 0.0f, 0.0f, 1.0),
+			_face(-1) {}
 		/// <param name="ray">Ray that caused the hit.</param>
 		/// <param name="distance">Distance from the ray origin to the intersection.</param>
 		/// <param name="intersection">Intersection point where the hit occured.</param>
@@ -593,13 +802,16 @@ namespace ray
 		/// <param name="normal">Surface normal on the shape where the hit occured.</param>
 		/// <param name="tangent">Surface tangent on the shape where the hit occured.</param>
 		/// <param name="binormal">Surface binormal on the shape where the hit occured.</param>
+		/// <param name="face">Index of the face of the shape that was hit, negative if the shape has no faces.</param>
 		inline rayhit_t(
 			const ray_t& ray,
 			const float distance,
-			const glm::vec4& intersection) :
+			const glm::vec4& intersection,
+			const int face = -1) :
 			_ray(ray),
 			_distance(distance),
-			_intersection(intersection) {}
+			_intersection(intersection),
+			_face(face) {}
 		inline ~rayhit_t() {}
 		
 		/// <summary>
@@ -619,6 +831,10 @@ namespace ray
 		/// Intersection point where the hit occured.
 		/// </summary>
 		glm::vec4 _intersection;
+		/// <summary>
+		/// Index of the face of the shape that was hit, negative if the shape has no faces.
+		/// </summary>
+		int _face;
 		
 	};
 	
@@ -632,7 +848,6 @@ namespace ray
 			_material(0),
 			_position(0.0f),
 			_texcoord(0.0f),
-			_space(1.0f),
 			_normal(0.0f, 0.0f, 1.0f),
 			_tangent(1.0f, 0.0f, 0.0f),
 			_binormal(0.0f, 1.0f, 0.0f),
@@ -670,7 +885,6 @@ namespace ray
 			_material(material),
 			_position(position),
 			_texcoord(texcoord),
-			_space(tangent, binormal, normal),
 			_normal(normal),
 			_tangent(tangent),
 			_binormal(binormal),
@@ -685,8 +899,22 @@ namespace ray
 		/// <summary>
 		/// Bounces the given ray off of the fragment position and surface normal.
 		/// </summary>
+		/// <param name="ray">Ray that hit the fragment.</param>
+		/// <param name="bias">Distance to move the origin off of the surface, so the ray does not hit it again.</param>
 		/// <returns>Transformed ray that has been reflected.</returns>
-		inline ray_t reflect(const ray_t& ray) { return ray_t(this->_position, glm::reflect(-ray._forward, this->_normal)); }
+		inline ray_t reflect(const ray_t& ray, const float bias = 0.001f) const { return ray_t(glm::vec3(this->_position) + (this->_normal * bias), glm::reflect(ray._forward, this->_normal)); }
+		/// <summary>
+		/// Continues the given ray through the fragment position, on the far side of the surface.
+		/// </summary>
+		/// <param name="ray">Ray that hit the fragment.</param>
+		/// <param name="bias">Distance to move the origin off of the surface, so the ray does not hit it again.</param>
+		/// <returns>Ray that has passed through the surface.</returns>
+		inline ray_t passthrough(const ray_t& ray, const float bias = 0.001f) const { return ray_t(glm::vec3(this->_position) - (this->_normal * bias), ray._forward); }
+		
+		/// <summary>
+		/// Gets the surface space matrix at the position, built from the tangent, binormal and normal.
+		/// </summary>
+		inline glm::mat3 space() const { return glm::mat3(this->_tangent, this->_binormal, this->_normal); }
 		
 		/// <summary>
 		/// Surface's material.
@@ -701,10 +929,6 @@ namespace ray
 		/// </summary>
 		glm::vec2 _texcoord;
 		/// <summary>
-		/// Surface space matrix at the position.
-		/// </summary>
-		glm::mat3 _space;
-		/// <summary>
 		/// Surface normal at the position.
 		/// </summary>
 		glm::vec3 _normal;
@@ -10,104 +10,33 @@ namespace ray
 		float a = 1.0f / ray._forward.x;
 		float b = 1.0f / ray._forward.y;
 		float c = 1.0f / ray._forward.z;
-		float txmin = a >= 0.0f ? (this->_p0.x - ray._origin.x) * a : (this->_p1.x - ray._origin.x) * a;
-		float tymin = b >= 0.0f ? (this->_p0.y - ray._origin.y) * b : (this->_p1.y - ray._origin.y) * b;
-		float tzmin = c >= 0.0f ? (this->_p0.z - ray._origin.z) * c : (this->_p1.z - ray._origin.z) * c;
-		float txmax = a >= 0.0f ? (this->_p1.x - ray._origin.x) * a : (this->_p0.x - ray._origin.x) * a;
-		float tymax = b >= 0.0f ? (this->_p1.y - ray._origin.y) * b : (this->_p0.y - ray._origin.y) * b;
-		float tzmax = c >= 0.0f ? (this->_p1.z - ray._origin.z) * c : (this->_p0.z - ray._origin.z) * c;
-		float t0 = txmin > tymin ? txmin : tymin;
-		float t1 = txmax < tymax ? txmax : tymax;
-		// int facein = txmin > tymin ? ((a >= 0.0f) ? 0 : 3) : ((b >= 0.0f) ? 1 : 4);
-		// int faceout = txmax < tymax ? ((a >= 0.0f) ? 3 : 0) : ((b >= 0.0f) ? 4 : 1);
-		if (tzmin > t0)
+		float tx0 = (this->_p0.x - ray._origin.x) * a;
+		float tx1 = (this->_p1.x - ray._origin.x) * a;
+		float ty0 = (this->_p0.y - ray._origin.y) * b;
+		float ty1 = (this->_p1.y - ray._origin.y) * b;
+		float tz0 = (this->_p0.z - ray._origin.z) * c;
+		float tz1 = (this->_p1.z - ray._origin.z) * c;
+		float nx = std::min(tx0, tx1);
+		float ny = std::min(ty0, ty1);
+		float nz = std::min(tz0, tz1);
+		float fx = std::max(tx0, tx1);
+		float fy = std::max(ty0, ty1);
+		float fz = std::max(tz0, tz1);
+		float t0 = std::max(std::max(nx, ny), nz);
+		float t1 = std::min(std::min(fx, fy), fz);
+		if (t0 < t1 && t1 > cubeepsilon)
 		{
-			t0 = tzmin;
-			// facein = (c >= 0.0f) ? 2 : 5;
-		}
+			// Entering through the slab that was crossed last, or leaving through the one crossed first when the ray starts inside, as passthrough rays do.
+			float t = t0 > cubeepsilon ? t0 : t1;
+			int face = t0 > cubeepsilon ?
+				(t0 == nz ? (c >= 0.0f ? 2 : 5) : (t0 == ny ? (b >= 0.0f ? 1 : 4) : (a >= 0.0f ? 0 : 3))) :
+				(t1 == fz ? (c >= 0.0f ? 5 : 2) : (t1 == fy ? (b >= 0.0f ? 4 : 1) : (a >= 0.0f ? 3 : 0)));
+			if (hit != 0)
+			{
+				*hit = rayhit_t(ray, t, ray._origin + vec4(ray._forward * t, 0.0f), face);
+			}
 
-		if (tzmax < t1)
-		{
-			t1 = tzmax;
-			// faceout = (c >= 0.0f) ? 5 : 2;
-		}
-
-		float kEpsilon = 1.0f;
-		if (t0 < t1 && t1 > kEpsilon)
-		{
-			float t = t0 > kEpsilon ? t0 : t1;
-
-			//if (t <= ray.length)
-			//{
-				vec4 intersection = ray._origin + vec4(ray._forward * t, 0.0f);
-				//float width = abs(this->_p1.x - this->_p0.x);
-				//float height = abs(this->_p1.y - this->_p0.y);
-				//float depth = abs(this->_p1.z - this->_p0.z);
-				//vec3 toInnerEdge(this->_p0 - intersection);
-				//vec3 toOuterEdge(this->_p1 - intersection);
-				//vec2 texcoord;
-				//vec3 normal;
-				//vec3 tangent;
-				//vec3 binormal;
-				//switch (facein)
-				//{
-				//case 0:
-				//	texcoord = vec2(abs(toOuterEdge.z) / (depth), abs(toInnerEdge.y) / (height));
-				//	normal = vec3(-1.0f, 0.0f, 0.0f);
-				//	tangent = vec3(0.0f, 0.0f, -1.0f);
-				//	binormal = vec3(0.0f, -1.0f, 0.0f);
-				//	break;
-				//case 1:
-				//	texcoord = vec2(abs(toInnerEdge.x) / (width), abs(toOuterEdge.z) / (depth));
-				//	normal = vec3(0.0f, -1.0f, 0.0f);
-				//	tangent = vec3(1.0f, 0.0f, 0.0f);
-				//	binormal = vec3(0.0f, 0.0f, -1.0f);
-				//	break;
-				//case 2:
-				//	texcoord = vec2(abs(toInnerEdge.x) / (width), abs(toInnerEdge.y) / (height));
-				//	normal = vec3(0.0f, 0.0f, -1.0f);
-				//	tangent = vec3(1.0f, 0.0f, 0.0f);
-				//	binormal = vec3(0.0f, -1.0f, 0.0f);
-				//	break;
-				//case 3:
-				//	texcoord = vec2(abs(toInnerEdge.z) / (depth), abs(toInnerEdge.y) / (height));
-				//	normal = vec3(1.0f, 0.0f, 0.0f);
-				//	tangent = vec3(0.0f, 0.0f, 1.0f);
-				//	binormal = vec3(0.0f, 1.0f, 0.0f);
-				//	break;
-				//case 4:
-				//	texcoord = vec2(abs(toInnerEdge.x) / (width), abs(toInnerEdge.z) / (depth));
-				//	normal = vec3(0.0f, 1.0f, 0.0f);
-				//	tangent = vec3(1.0f, 0.0f, 0.0f);
-				//	binormal = vec3(0.0f, 0.0f, 1.0f);
-				//	break;
-				//case 5:
-				//	texcoord = vec2(abs(toOuterEdge.x) / (width), abs(toInnerEdge.y) / (height));
-				//	normal = vec3(0.0f, 0.0f, 1.0f);
-				//	tangent = vec3(1.0f, 0.0f, 0.0f);
-				//	binormal = vec3(0.0f, 1.0f, 0.0f);
-				//	break;
-				//default:
-				//	break;
-				//}
-
-				//if (dot(normal, ray._forward) < 0.0f)
-				//{
-					if (hit != 0)
-					{
-						*hit = rayhit_t(
-							ray,
-							t,
-							intersection/*,
-							texcoord,
-							normal,
-							tangent,
-							binormal*/);
-					}
-
-					return true;
-				//}
-			//}
+			return true;
 		}
 
 		return false;
@@ -115,13 +44,14 @@ namespace ray
 	
 	fragment_t traceaxiscube_t::fragmentate(const rayhit_t& hit) const
 	{
-		float a = 1.0f / hit._ray._forward.x;
-		float b = 1.0f / hit._ray._forward.y;
-		float c = 1.0f / hit._ray._forward.z;
-		float txmin = a >= 0.0f ? (this->_p0.x - hit._ray._origin.x) * a : (this->_p1.x - hit._ray._origin.x) * a;
-		float tymin = b >= 0.0f ? (this->_p0.y - hit._ray._origin.y) * b : (this->_p1.y - hit._ray._origin.y) * b;
-		float tzmin = c >= 0.0f ? (this->_p0.z - hit._ray._origin.z) * c : (this->_p1.z - hit._ray._origin.z) * c;
-		int face = tzmin > hit._distance ? (txmin > tymin ? ((a >= 0.0f) ? 0 : 3) : ((b >= 0.0f) ? 1 : 4)) : ((c >= 0.0f) ? 2 : 5);
+		int face = hit._face;
+		if (face < 0)
+		{
+			rayhit_t slabs;
+			this->hitbyray(hit._ray, &slabs);
+			face = slabs._face;
+		}
+		
 		float width = abs(this->_p1.x - this->_p0.x);
 		float height = abs(this->_p1.y - this->_p0.y);
 		float depth = abs(this->_p1.z - this->_p0.z);
@@ -131,6 +61,8 @@ namespace ray
 		vec3 normal;
 		vec3 tangent;
 		vec3 binormal;
+		ivec2 axes(0, 1);
+		vec2 extent(1.0f);
 		switch (face)
 		{
 		case 0:
@@ -138,42 +70,54 @@ namespace ray
 			normal = vec3(-1.0f, 0.0f, 0.0f);
 			tangent = vec3(0.0f, 0.0f, -1.0f);
 			binormal = vec3(0.0f, -1.0f, 0.0f);
+			axes = ivec2(2, 1);
+			extent = vec2(depth, height);
 			break;
 		case 1:
 			texcoord = vec2(abs(toInnerEdge.x) / (width), abs(toOuterEdge.z) / (depth));
 			normal = vec3(0.0f, -1.0f, 0.0f);
 			tangent = vec3(1.0f, 0.0f, 0.0f);
 			binormal = vec3(0.0f, 0.0f, -1.0f);
+			axes = ivec2(0, 2);
+			extent = vec2(width, depth);
 			break;
 		case 2:
 			texcoord = vec2(abs(toInnerEdge.x) / (width), abs(toInnerEdge.y) / (height));
 			normal = vec3(0.0f, 0.0f, -1.0f);
 			tangent = vec3(1.0f, 0.0f, 0.0f);
 			binormal = vec3(0.0f, -1.0f, 0.0f);
+			axes = ivec2(0, 1);
+			extent = vec2(width, height);
 			break;
 		case 3:
 			texcoord = vec2(abs(toInnerEdge.z) / (depth), abs(toInnerEdge.y) / (height));
 			normal = vec3(1.0f, 0.0f, 0.0f);
 			tangent = vec3(0.0f, 0.0f, 1.0f);
 			binormal = vec3(0.0f, 1.0f, 0.0f);
+			axes = ivec2(2, 1);
+			extent = vec2(depth, height);
 			break;
 		case 4:
 			texcoord = vec2(abs(toInnerEdge.x) / (width), abs(toInnerEdge.z) / (depth));
 			normal = vec3(0.0f, 1.0f, 0.0f);
 			tangent = vec3(1.0f, 0.0f, 0.0f);
 			binormal = vec3(0.0f, 0.0f, 1.0f);
+			axes = ivec2(0, 2);
+			extent = vec2(width, depth);
 			break;
 		case 5:
 			texcoord = vec2(abs(toOuterEdge.x) / (width), abs(toInnerEdge.y) / (height));
 			normal = vec3(0.0f, 0.0f, 1.0f);
 			tangent = vec3(1.0f, 0.0f, 0.0f);
 			binormal = vec3(0.0f, 1.0f, 0.0f);
+			axes = ivec2(0, 1);
+			extent = vec2(width, height);
 			break;
 		default:
 			break;
 		}
-
-		return fragment_t(
+		
+		fragment_t fragment(
 			this->_material,
 			hit._intersection,
 			texcoord,
@@ -181,11 +125,284 @@ namespace ray
 			tangent,
 			binormal,
 			-hit._ray._forward,
-			this->_material != 0 ? this->_material->transparency(texcoord) : 0.0f,
-			this->_material != 0 ? this->_material->reflectivity(texcoord) : 0.0f,
-			this->_material != 0 ? this->_material->color(texcoord) : vec4(1.0f, 0.0f, 1.0f, 1.0f),
-			this->_material != 0 ? this->_material->specular(texcoord) : vec4(0.0f),
-			this->_material != 0 ? this->_material->emissive(texcoord) : vec4(0.0f));
+			0.0f,
+			0.0f,
+			vec4(1.0f, 0.0f, 1.0f, 1.0f),
+			vec4(0.0f),
+			vec4(0.0f));
+		if (this->_material != 0)
+		{
+			float footprint = 0.0f;
+			if (this->_material->sampled() != 0)
+			{
+				vec3 dpdx;
+				vec3 dpdy;
+				hit._ray._differential.transfer(hit._ray._forward, hit._distance, normal, dpdx, dpdy);
+				vec2 duvdx = vec2(dpdx[axes.x], dpdx[axes.y]) / extent;
+				vec2 duvdy = vec2(dpdy[axes.x], dpdy[axes.y]) / extent;
+				footprint = max(length(duvdx), length(duvdy));
+			}
+			
+			this->_material->surface(fragment, footprint);
+		}
+		
+		return fragment;
+	}
+	
+	bounds_t traceaxiscube_t::bounds() const
+	{
+		return bounds_t(vec3(this->_p0), vec3(this->_p1));
+	}
+	
+	void cubearray_t::clear()
+	{
+		this->_x0.clear();
+		this->_y0.clear();
+		this->_z0.clear();
+		this->_x1.clear();
+		this->_y1.clear();
+		this->_z1.clear();
+		this->_sources.clear();
+	}
+	
+	void cubearray_t::push_back(const traceaxiscube_t* cube)
+	{
+		this->_x0.push_back(cube->p0().x);
+		this->_y0.push_back(cube->p0().y);
+		this->_z0.push_back(cube->p0().z);
+		this->_x1.push_back(cube->p1().x);
+		this->_y1.push_back(cube->p1().y);
+		this->_z1.push_back(cube->p1().z);
+		this->_sources.push_back(cube);
+	}
+	
+	static bool nearest_scalar(const cubearray_t& cubes, const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, int& face, const bool anyhit)
+	{
+		bool found = false;
+		for (size_t i = begin; i < end; i++)
+		{
+			float t = 0.0f;
+			int f = 0;
+			if (cubes.hitbyray(i, ray, t, f) && t < distance)
+			{
+				distance = t;
+				index = i;
+				face = f;
+				found = true;
+				if (anyhit)
+				{
+					return true;
+				}
+			}
+		}
+		
+		return found;
+	}
+	
+	/// <summary>
+	/// Folds the per lane results of a vector kernel into the nearest hit, preferring the lowest index on ties like the scalar loop does.
+	/// </summary>
+	static bool nearest_lanes(const float* lanes, const int32_t* indices, const int32_t* faces, const size_t count, float& distance, size_t& index, int& face)
+	{
+		bool found = false;
+		for (size_t k = 0; k < count; k++)
+		{
+			if (indices[k] >= 0 && (lanes[k] < distance || (found && lanes[k] == distance && size_t(indices[k]) < index)))
+			{
+				distance = lanes[k];
+				index = size_t(indices[k]);
+				face = faces[k];
+				found = true;
+			}
+		}
+		
+		return found;
+	}
+	
+#if defined(RAYTRACER_SSE)
+	static inline __m128 select_sse(const __m128 mask, const __m128 a, const __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+	
+	static inline __m128i select_sse(const __m128 mask, const __m128i a, const __m128i b)
+	{
+		__m128i m = _mm_castps_si128(mask);
+		return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+	}
+	
+	static bool nearest_sse(const cubearray_t& cubes, const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, int& face, const bool anyhit)
+	{
+		const float a = 1.0f / ray._forward.x;
+		const float b = 1.0f / ray._forward.y;
+		const float c = 1.0f / ray._forward.z;
+		const __m128 ox = _mm_set1_ps(ray._origin.x);
+		const __m128 oy = _mm_set1_ps(ray._origin.y);
+		const __m128 oz = _mm_set1_ps(ray._origin.z);
+		const __m128 ix = _mm_set1_ps(a);
+		const __m128 iy = _mm_set1_ps(b);
+		const __m128 iz = _mm_set1_ps(c);
+		const __m128 epsilon = _mm_set1_ps(cubeepsilon);
+		// The sign of the ray decides which side of each slab is the way in, so every face is a constant per ray.
+		const __m128i inx = _mm_set1_epi32(a >= 0.0f ? 0 : 3);
+		const __m128i iny = _mm_set1_epi32(b >= 0.0f ? 1 : 4);
+		const __m128i inz = _mm_set1_epi32(c >= 0.0f ? 2 : 5);
+		const __m128i outx = _mm_set1_epi32(a >= 0.0f ? 3 : 0);
+		const __m128i outy = _mm_set1_epi32(b >= 0.0f ? 4 : 1);
+		const __m128i outz = _mm_set1_epi32(c >= 0.0f ? 5 : 2);
+		__m128 best = _mm_set1_ps(distance);
+		__m128i bestindex = _mm_set1_epi32(-1);
+		__m128i bestface = _mm_set1_epi32(-1);
+		__m128i lane = _mm_setr_epi32(int32_t(begin), int32_t(begin + 1), int32_t(begin + 2), int32_t(begin + 3));
+		const __m128i step = _mm_set1_epi32(4);
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cubes._x0[i]), ox), ix);
+			__m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cubes._x1[i]), ox), ix);
+			__m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cubes._y0[i]), oy), iy);
+			__m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cubes._y1[i]), oy), iy);
+			__m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cubes._z0[i]), oz), iz);
+			__m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&cubes._z1[i]), oz), iz);
+			__m128 nx = _mm_min_ps(tx0, tx1);
+			__m128 ny = _mm_min_ps(ty0, ty1);
+			__m128 nz = _mm_min_ps(tz0, tz1);
+			__m128 fx = _mm_max_ps(tx0, tx1);
+			__m128 fy = _mm_max_ps(ty0, ty1);
+			__m128 fz = _mm_max_ps(tz0, tz1);
+			__m128 t0 = _mm_max_ps(_mm_max_ps(nx, ny), nz);
+			__m128 t1 = _mm_min_ps(_mm_min_ps(fx, fy), fz);
+			__m128 entry = _mm_cmpgt_ps(t0, epsilon);
+			__m128 t = select_sse(entry, t0, t1);
+			__m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(t0, t1), _mm_cmpgt_ps(t1, epsilon)), _mm_cmplt_ps(t, best));
+			__m128i in = select_sse(_mm_cmpeq_ps(t0, nz), inz, select_sse(_mm_cmpeq_ps(t0, ny), iny, inx));
+			__m128i out = select_sse(_mm_cmpeq_ps(t1, fz), outz, select_sse(_mm_cmpeq_ps(t1, fy), outy, outx));
+			best = select_sse(mask, t, best);
+			bestindex = select_sse(mask, lane, bestindex);
+			bestface = select_sse(mask, select_sse(entry, in, out), bestface);
+			lane = _mm_add_epi32(lane, step);
+			if (anyhit && _mm_movemask_ps(mask) != 0)
+			{
+				break;
+			}
+		}
+		
+		float lanes[4];
+		int32_t indices[4];
+		int32_t faces[4];
+		_mm_storeu_ps(lanes, best);
+		_mm_storeu_si128((__m128i*)indices, bestindex);
+		_mm_storeu_si128((__m128i*)faces, bestface);
+		bool found = nearest_lanes(lanes, indices, faces, 4, distance, index, face);
+		if (found && anyhit)
+		{
+			return true;
+		}
+		
+		return nearest_scalar(cubes, ray, i, end, distance, index, face, anyhit) || found;
+	}
+#endif
+	
+#if defined(RAYTRACER_AVX2)
+	RAYTRACER_AVX2 static bool nearest_avx2(const cubearray_t& cubes, const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, int& face, const bool anyhit)
+	{
+		const float a = 1.0f / ray._forward.x;
+		const float b = 1.0f / ray._forward.y;
+		const float c = 1.0f / ray._forward.z;
+		const __m256 ox = _mm256_set1_ps(ray._origin.x);
+		const __m256 oy = _mm256_set1_ps(ray._origin.y);
+		const __m256 oz = _mm256_set1_ps(ray._origin.z);
+		const __m256 ix = _mm256_set1_ps(a);
+		const __m256 iy = _mm256_set1_ps(b);
+		const __m256 iz = _mm256_set1_ps(c);
+		const __m256 epsilon = _mm256_set1_ps(cubeepsilon);
+		const __m256 inx = _mm256_castsi256_ps(_mm256_set1_epi32(a >= 0.0f ? 0 : 3));
+		const __m256 iny = _mm256_castsi256_ps(_mm256_set1_epi32(b >= 0.0f ? 1 : 4));
+		const __m256 inz = _mm256_castsi256_ps(_mm256_set1_epi32(c >= 0.0f ? 2 : 5));
+		const __m256 outx = _mm256_castsi256_ps(_mm256_set1_epi32(a >= 0.0f ? 3 : 0));
+		const __m256 outy = _mm256_castsi256_ps(_mm256_set1_epi32(b >= 0.0f ? 4 : 1));
+		const __m256 outz = _mm256_castsi256_ps(_mm256_set1_epi32(c >= 0.0f ? 5 : 2));
+		__m256 best = _mm256_set1_ps(distance);
+		__m256 bestindex = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		__m256 bestface = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		__m256i lane = _mm256_add_epi32(_mm256_set1_epi32(int32_t(begin)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		const __m256i step = _mm256_set1_epi32(8);
+		size_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&cubes._x0[i]), ox), ix);
+			__m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&cubes._x1[i]), ox), ix);
+			__m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&cubes._y0[i]), oy), iy);
+			__m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&cubes._y1[i]), oy), iy);
+			__m256 tz0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&cubes._z0[i]), oz), iz);
+			__m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&cubes._z1[i]), oz), iz);
+			__m256 nx = _mm256_min_ps(tx0, tx1);
+			__m256 ny = _mm256_min_ps(ty0, ty1);
+			__m256 nz = _mm256_min_ps(tz0, tz1);
+			__m256 fx = _mm256_max_ps(tx0, tx1);
+			__m256 fy = _mm256_max_ps(ty0, ty1);
+			__m256 fz = _mm256_max_ps(tz0, tz1);
+			__m256 t0 = _mm256_max_ps(_mm256_max_ps(nx, ny), nz);
+			__m256 t1 = _mm256_min_ps(_mm256_min_ps(fx, fy), fz);
+			__m256 entry = _mm256_cmp_ps(t0, epsilon, _CMP_GT_OQ);
+			__m256 t = _mm256_blendv_ps(t1, t0, entry);
+			__m256 mask = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(t0, t1, _CMP_LT_OQ), _mm256_cmp_ps(t1, epsilon, _CMP_GT_OQ)), _mm256_cmp_ps(t, best, _CMP_LT_OQ));
+			__m256 in = _mm256_blendv_ps(_mm256_blendv_ps(inx, iny, _mm256_cmp_ps(t0, ny, _CMP_EQ_OQ)), inz, _mm256_cmp_ps(t0, nz, _CMP_EQ_OQ));
+			__m256 out = _mm256_blendv_ps(_mm256_blendv_ps(outx, outy, _mm256_cmp_ps(t1, fy, _CMP_EQ_OQ)), outz, _mm256_cmp_ps(t1, fz, _CMP_EQ_OQ));
+			best = _mm256_blendv_ps(best, t, mask);
+			bestindex = _mm256_blendv_ps(bestindex, _mm256_castsi256_ps(lane), mask);
+			bestface = _mm256_blendv_ps(bestface, _mm256_blendv_ps(out, in, entry), mask);
+			lane = _mm256_add_epi32(lane, step);
+			if (anyhit && _mm256_movemask_ps(mask) != 0)
+			{
+				break;
+			}
+		}
+		
+		float lanes[8];
+		int32_t indices[8];
+		int32_t faces[8];
+		_mm256_storeu_ps(lanes, best);
+		_mm256_storeu_ps((float*)indices, bestindex);
+		_mm256_storeu_ps((float*)faces, bestface);
+		bool found = nearest_lanes(lanes, indices, faces, 8, distance, index, face);
+		if (found && anyhit)
+		{
+			return true;
+		}
+		
+		return nearest_sse(cubes, ray, i, end, distance, index, face, anyhit) || found;
+	}
+#endif
+	
+	static bool intersect(const cubearray_t& cubes, const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, int& face, const bool anyhit)
+	{
+		switch (simdlevel())
+		{
+#if defined(RAYTRACER_AVX2)
+		case SIMDTYPE_AVX2:
+			return nearest_avx2(cubes, ray, begin, end, distance, index, face, anyhit);
+#endif
+#if defined(RAYTRACER_SSE)
+		case SIMDTYPE_SSE:
+			return nearest_sse(cubes, ray, begin, end, distance, index, face, anyhit);
+#endif
+		default:
+			return nearest_scalar(cubes, ray, begin, end, distance, index, face, anyhit);
+		}
+	}
+	
+	bool cubearray_t::nearest(const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, int& face) const
+	{
+		return intersect(*this, ray, begin, end, distance, index, face, false);
+	}
+	
+	bool cubearray_t::occluded(const ray_t& ray, const size_t begin, const size_t end, const float distance) const
+	{
+		float t = distance;
+		size_t index = 0;
+		int face = -1;
+		return intersect(*this, ray, begin, end, t, index, face, true);
 	}
 	
 }
\ No newline at end of file
@@ -0,0 +1,917 @@
+#include "../include/RayTracer.h"
+
+namespace ray
+{
+
+	const size_t raypacket_t::maxsize;
+	const size_t bvh_t::maxdepth;
+	const size_t bvh_t::maxleaf;
+	const size_t bvh_t::binsize;
+	const uint32_t bvh_t::nosubtree;
+
+	/// <summary>
+	/// Cost of walking through an interior node, relative to testing a single object.
+	/// </summary>
+	static const float traversalcost = 0.125f;
+
+	/// <summary>
+	/// Fewest objects in a range before its bins are filled across the thread pool rather than on the calling thread.
+	/// </summary>
+	static const size_t parallelbins = 1 << 16;
+
+	/// <summary>
+	/// Fewest objects in a range that is built as its own task.
+	/// </summary>
+	static const size_t mingrain = 1 << 12;
+
+	/// <summary>
+	/// Largest number of objects in a leaf of a linear hierarchy.
+	/// </summary>
+	static const size_t linearleaf = 4;
+
+	/// <summary>
+	/// Most objects that are given 30-bit Morton codes, more objects are given 63-bit codes so that close ones still get codes of their own.
+	/// </summary>
+	static const size_t shortcodes = 1 << 20;
+
+	/// <summary>
+	/// Fewest objects before Morton codes are computed and sorted across the thread pool rather than on the calling thread.
+	/// </summary>
+	static const size_t parallelsort = 1 << 14;
+
+	/// <summary>
+	/// Runs the given task once for every chunk, across the pool if there is one and on the calling thread otherwise.
+	/// </summary>
+	static inline void runchunks(threadpool_t* pool, const size_t chunks, const threadpool_t::task_t& task)
+	{
+		if (pool != 0)
+		{
+			pool->dispatch(chunks, task);
+			return;
+		}
+
+		for (size_t i = 0; i < chunks; i++)
+		{
+			task(i, 0);
+		}
+	}
+
+	/// <summary>
+	/// Spreads the low 21 bits of a value out to every third bit.
+	/// </summary>
+	static inline uint64_t spreadbits(uint64_t x)
+	{
+		x &= 0x1fffffull;
+		x = (x | (x << 32)) & 0x1f00000000ffffull;
+		x = (x | (x << 16)) & 0x1f0000ff0000ffull;
+		x = (x | (x << 8)) & 0x100f00f00f00f00full;
+		x = (x | (x << 4)) & 0x10c30c30c30c30c3ull;
+		x = (x | (x << 2)) & 0x1249249249249249ull;
+		return x;
+	}
+
+	/// <summary>
+	/// Gets the index of the highest set bit of a value, which must not be zero.
+	/// </summary>
+	static inline int highestbit(const uint64_t x)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse64(&index, x);
+		return int(index);
+#else
+		return 63 - __builtin_clzll(x);
+#endif
+	}
+
+	/// <summary>
+	/// Sorts keys and their values by the given number of low bits of the keys, a byte at a time from the lowest.
+	/// Each chunk counts its digits and scatters its keys on its own, into offsets laid out digit by digit and then chunk by chunk,
+	/// so the sort is stable and the same whether or not it runs on a pool. Passes where every key has the same digit are skipped.
+	/// </summary>
+	static void radixsort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, const size_t bits, threadpool_t* pool)
+	{
+		size_t count = keys.size();
+		size_t chunks = pool != 0 ? pool->size() * 4 : 1;
+		std::vector<uint64_t> sortedkeys(count);
+		std::vector<uint32_t> sortedvalues(count);
+		std::vector<size_t> offsets(chunks * 256);
+		for (size_t shift = 0; shift < bits; shift += 8)
+		{
+			std::fill(offsets.begin(), offsets.end(), 0);
+			runchunks(pool, chunks, [&keys, &offsets, shift, chunks, count](const size_t index, const size_t worker)
+			{
+				size_t* histogram = &offsets[index * 256];
+				for (size_t i = (count * index) / chunks; i < (count * (index + 1)) / chunks; i++)
+				{
+					histogram[(keys[i] >> shift) & 0xff]++;
+				}
+			});
+
+			bool skip = false;
+			size_t offset = 0;
+			for (size_t digit = 0; digit < 256; digit++)
+			{
+				size_t total = 0;
+				for (size_t chunk = 0; chunk < chunks; chunk++)
+				{
+					size_t n = offsets[(chunk * 256) + digit];
+					offsets[(chunk * 256) + digit] = offset;
+					offset += n;
+					total += n;
+				}
+
+				skip = skip || total == count;
+			}
+
+			if (skip)
+			{
+				continue;
+			}
+
+			runchunks(pool, chunks, [&keys, &values, &sortedkeys, &sortedvalues, &offsets, shift, chunks, count](const size_t index, const size_t worker)
+			{
+				size_t* offset = &offsets[index * 256];
+				for (size_t i = (count * index) / chunks; i < (count * (index + 1)) / chunks; i++)
+				{
+					size_t to = offset[(keys[i] >> shift) & 0xff]++;
+					sortedkeys[to] = keys[i];
+					sortedvalues[to] = values[i];
+				}
+			});
+
+			keys.swap(sortedkeys);
+			values.swap(sortedvalues);
+		}
+	}
+
+	/// <summary>
+	/// Contains properties for one bin of the centers of a range's objects along an axis.
+	/// </summary>
+	struct bvhbin_t
+	{
+		inline bvhbin_t() :
+			_count(0) {}
+
+		bounds_t _box;
+		bounds_t _spread;
+		size_t _count;
+	};
+
+	/// <summary>
+	/// Gets the bin of a center along a single axis of a range's spread.
+	/// </summary>
+	static inline size_t binof(const float center, const float minimum, const float scale)
+	{
+		return std::min(size_t(std::max((center - minimum) * scale, 0.0f)), bvh_t::binsize - 1);
+	}
+
+	/// <summary>
+	/// Sorts the objects of part of a range into bins along every axis that its spread is not flat on.
+	/// </summary>
+	template <typename T> static void fillbins(const T* references, const size_t count, const bounds_t& spread, const glm::vec3& scale, bvhbin_t* bins)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const T& reference = references[i];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (scale[axis] > 0.0f)
+				{
+					bvhbin_t& bin = bins[(axis * bvh_t::binsize) + binof(reference._center[axis], spread._min[axis], scale[axis])];
+					bin._box.expand(reference._box);
+					bin._spread.expand(reference._center);
+					bin._count++;
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Orders references by their centers on a single axis.
+	/// </summary>
+	struct centerorder_t
+	{
+		inline centerorder_t(const int axis) :
+			_axis(axis) {}
+
+		template <typename T> inline bool operator()(const T& a, const T& b) const { return a._center[this->_axis] < b._center[this->_axis]; }
+
+		int _axis;
+	};
+
+	/// <summary>
+	/// Tells whether a reference's center falls into a bin before the split bin on a single axis.
+	/// </summary>
+	struct binorder_t
+	{
+		inline binorder_t(const int axis, const float minimum, const float scale, const size_t split) :
+			_axis(axis),
+			_minimum(minimum),
+			_scale(scale),
+			_split(split) {}
+
+		template <typename T> inline bool operator()(const T& reference) const { return binof(reference._center[this->_axis], this->_minimum, this->_scale) < this->_split; }
+
+		int _axis;
+		float _minimum;
+		float _scale;
+		size_t _split;
+	};
+
+	void bvh_t::build(const std::vector<bounds_t>& bounds, const BVHTYPE type)
+	{
+		this->build(bounds, type, 0);
+	}
+	void bvh_t::build(const std::vector<bounds_t>& bounds, threadpool_t& pool, const BVHTYPE type)
+	{
+		this->build(bounds, type, &pool);
+	}
+
+	void bvh_t::build(const std::vector<bounds_t>& bounds, const BVHTYPE type, threadpool_t* pool)
+	{
+		this->clear();
+		if (bounds.empty() || type == BVHTYPE_NONE)
+		{
+			return;
+		}
+
+		if (type == BVHTYPE_LBVH)
+		{
+			this->linear(bounds, pool);
+			return;
+		}
+
+		std::vector<reference_t> references(bounds.size());
+		range_t range;
+		range._end = bounds.size();
+		for (size_t i = 0; i < bounds.size(); i++)
+		{
+			references[i]._box = bounds[i];
+			references[i]._center = bounds[i].center();
+			references[i]._index = (uint32_t)i;
+			range._box.expand(bounds[i]);
+			range._spread.expand(references[i]._center);
+		}
+
+		this->_nodes.reserve(bounds.size() * 2);
+		if (pool != 0)
+		{
+			// Enough subtrees are left over for every worker to take several, so the pool can even out how long each of them takes.
+			size_t grain = std::max(bounds.size() / (pool->size() * 8), mingrain);
+			std::vector<bvhnode_t> top;
+			std::vector<uint32_t> owners;
+			std::vector<range_t> subtrees;
+			this->plan(top, owners, subtrees, references, range, grain, *pool);
+			pool->dispatch(subtrees.size(), [this, &subtrees, &references](const size_t index, const size_t worker)
+			{
+				range_t& subtree = subtrees[index];
+				subtree._nodes.reserve(subtree.count() * 2);
+				this->build(subtree._nodes, references, subtree);
+			});
+
+			this->splice(top, owners, subtrees, 0);
+		}
+		else
+		{
+			this->build(this->_nodes, references, range);
+		}
+
+		this->_indices.resize(bounds.size());
+		for (size_t i = 0; i < references.size(); i++)
+		{
+			this->_indices[i] = references[i]._index;
+		}
+	}
+
+	void bvh_t::linear(const std::vector<bounds_t>& bounds, threadpool_t* pool)
+	{
+		size_t count = bounds.size();
+		threadpool_t* workers = count >= parallelsort ? pool : 0;
+		size_t chunks = workers != 0 ? workers->size() * 4 : 1;
+		std::vector<bounds_t> spreads(chunks);
+		runchunks(workers, chunks, [&bounds, &spreads, chunks, count](const size_t index, const size_t worker)
+		{
+			for (size_t i = (count * index) / chunks; i < (count * (index + 1)) / chunks; i++)
+			{
+				spreads[index].expand(bounds[i].center());
+			}
+		});
+
+		bounds_t spread;
+		for (size_t i = 0; i < chunks; i++)
+		{
+			spread.expand(spreads[i]);
+		}
+
+		// Centers are quantized onto a grid over their spread, with as many cells along each axis as the codes have bits for it.
+		size_t bits = count > shortcodes ? 21 : 10;
+		float cells = float((1 << bits) - 1);
+		glm::vec3 extent = spread._max - spread._min;
+		glm::vec3 scale(0.0f);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			scale[axis] = extent[axis] > 0.0f ? cells / extent[axis] : 0.0f;
+		}
+
+		std::vector<uint64_t> codes(count);
+		this->_indices.resize(count);
+		runchunks(workers, chunks, [this, &bounds, &codes, &spread, &scale, cells, chunks, count](const size_t index, const size_t worker)
+		{
+			for (size_t i = (count * index) / chunks; i < (count * (index + 1)) / chunks; i++)
+			{
+				glm::vec3 cell = glm::clamp((bounds[i].center() - spread._min) * scale, 0.0f, cells);
+				codes[i] = (spreadbits(uint64_t(cell.x)) << 2) | (spreadbits(uint64_t(cell.y)) << 1) | spreadbits(uint64_t(cell.z));
+				this->_indices[i] = (uint32_t)i;
+			}
+		});
+
+		radixsort(codes, this->_indices, bits * 3, workers);
+		range_t range;
+		range._end = count;
+		this->_nodes.reserve(((count / linearleaf) + 1) * 2);
+		if (pool != 0)
+		{
+			size_t grain = std::max(count / (pool->size() * 8), mingrain);
+			std::vector<bvhnode_t> top;
+			std::vector<uint32_t> owners;
+			std::vector<range_t> subtrees;
+			this->plan(top, owners, subtrees, codes, range, grain);
+			pool->dispatch(subtrees.size(), [this, &subtrees, &bounds, &codes](const size_t index, const size_t worker)
+			{
+				range_t& subtree = subtrees[index];
+				subtree._nodes.reserve(((subtree.count() / linearleaf) + 1) * 2);
+				this->build(subtree._nodes, bounds, codes, subtree);
+			});
+
+			this->splice(top, owners, subtrees, 0);
+		}
+		else
+		{
+			this->build(this->_nodes, bounds, codes, range);
+		}
+	}
+
+	float bvh_t::cost() const
+	{
+		if (this->_nodes.empty() || this->_nodes[0]._bounds.area() <= 0.0f)
+		{
+			return 0.0f;
+		}
+
+		float cost = 0.0f;
+		for (std::vector<bvhnode_t>::const_iterator i = this->_nodes.begin(); i != this->_nodes.end(); i++)
+		{
+			cost += i->_bounds.area() * (i->leaf() ? float(i->_count) : traversalcost);
+		}
+
+		return cost / this->_nodes[0]._bounds.area();
+	}
+
+	packetfrustum_t::packetfrustum_t(const raypacket_t& packet) :
+		_coherent(true)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float* origin = packet._origin[axis];
+			const float* inverse = packet._inverse[axis];
+			float originmin = origin[0];
+			float originmax = origin[0];
+			float inversemin = inverse[0];
+			float inversemax = inverse[0];
+			for (size_t i = 1; i < packet._count; i++)
+			{
+				originmin = std::min(originmin, origin[i]);
+				originmax = std::max(originmax, origin[i]);
+				inversemin = std::min(inversemin, inverse[i]);
+				inversemax = std::max(inversemax, inverse[i]);
+			}
+
+			this->_originmin[axis] = originmin;
+			this->_originmax[axis] = originmax;
+			this->_inversemin[axis] = inversemin;
+			this->_inversemax[axis] = inversemax;
+			// A direction of zero on an axis turns into an infinite reciprocal, which the intervals cannot be multiplied through.
+			if (!(std::fabs(inversemin) < FLT_MAX && std::fabs(inversemax) < FLT_MAX) || (inversemin < 0.0f && inversemax > 0.0f))
+			{
+				this->_coherent = false;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Tests a box against the rays of a packet one at a time.
+	/// Each minimum and maximum keeps the operand order of the SSE instructions, so rays whose slabs turn out undefined are decided the same way.
+	/// </summary>
+	static uint64_t hit_scalar(const raypacket_t& packet, const bounds_t& bounds, const uint64_t mask, const float* distances, const size_t begin)
+	{
+		uint64_t result = 0;
+		for (size_t lane = begin; lane < packet._count; lane++)
+		{
+			if ((mask & (uint64_t(1) << lane)) == 0)
+			{
+				continue;
+			}
+
+			float enter = 0.0f;
+			float exit = distances[lane];
+			float tmin[3];
+			float tmax[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float t0 = (bounds._min[axis] - packet._origin[axis][lane]) * packet._inverse[axis][lane];
+				float t1 = (bounds._max[axis] - packet._origin[axis][lane]) * packet._inverse[axis][lane];
+				tmin[axis] = t0 < t1 ? t0 : t1;
+				tmax[axis] = t0 > t1 ? t0 : t1;
+			}
+
+			float xy = tmin[0] > tmin[1] ? tmin[0] : tmin[1];
+			float z = tmin[2] > enter ? tmin[2] : enter;
+			enter = xy > z ? xy : z;
+			xy = tmax[0] < tmax[1] ? tmax[0] : tmax[1];
+			z = tmax[2] < exit ? tmax[2] : exit;
+			exit = xy < z ? xy : z;
+			if (enter <= exit)
+			{
+				result |= uint64_t(1) << lane;
+			}
+		}
+
+		return result;
+	}
+
+#if defined(RAYTRACER_SSE)
+	static uint64_t hit_sse(const raypacket_t& packet, const bounds_t& bounds, const uint64_t mask, const float* distances, const size_t begin)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		__m128 bmin[3];
+		__m128 bmax[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			bmin[axis] = _mm_set1_ps(bounds._min[axis]);
+			bmax[axis] = _mm_set1_ps(bounds._max[axis]);
+		}
+
+		uint64_t result = 0;
+		size_t i = begin;
+		for (; i + 4 <= packet._count; i += 4)
+		{
+			if (((mask >> i) & 0xf) == 0)
+			{
+				continue;
+			}
+
+			__m128 tmin[3];
+			__m128 tmax[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				__m128 origin = _mm_loadu_ps(&packet._origin[axis][i]);
+				__m128 inverse = _mm_loadu_ps(&packet._inverse[axis][i]);
+				__m128 t0 = _mm_mul_ps(_mm_sub_ps(bmin[axis], origin), inverse);
+				__m128 t1 = _mm_mul_ps(_mm_sub_ps(bmax[axis], origin), inverse);
+				tmin[axis] = _mm_min_ps(t0, t1);
+				tmax[axis] = _mm_max_ps(t0, t1);
+			}
+
+			__m128 enter = _mm_max_ps(_mm_max_ps(tmin[0], tmin[1]), _mm_max_ps(tmin[2], zero));
+			__m128 exit = _mm_min_ps(_mm_min_ps(tmax[0], tmax[1]), _mm_min_ps(tmax[2], _mm_loadu_ps(&distances[i])));
+			result |= uint64_t(_mm_movemask_ps(_mm_cmple_ps(enter, exit))) << i;
+		}
+
+		return (result & mask) | hit_scalar(packet, bounds, mask, distances, i);
+	}
+#endif
+
+#if defined(RAYTRACER_AVX2)
+	RAYTRACER_AVX2 static uint64_t hit_avx2(const raypacket_t& packet, const bounds_t& bounds, const uint64_t mask, const float* distances, const size_t begin)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		__m256 bmin[3];
+		__m256 bmax[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			bmin[axis] = _mm256_set1_ps(bounds._min[axis]);
+			bmax[axis] = _mm256_set1_ps(bounds._max[axis]);
+		}
+
+		uint64_t result = 0;
+		size_t i = begin;
+		for (; i + 8 <= packet._count; i += 8)
+		{
+			if (((mask >> i) & 0xff) == 0)
+			{
+				continue;
+			}
+
+			__m256 tmin[3];
+			__m256 tmax[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				__m256 origin = _mm256_loadu_ps(&packet._origin[axis][i]);
+				__m256 inverse = _mm256_loadu_ps(&packet._inverse[axis][i]);
+				__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(bmin[axis], origin), inverse);
+				__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(bmax[axis], origin), inverse);
+				tmin[axis] = _mm256_min_ps(t0, t1);
+				tmax[axis] = _mm256_max_ps(t0, t1);
+			}
+
+			__m256 enter = _mm256_max_ps(_mm256_max_ps(tmin[0], tmin[1]), _mm256_max_ps(tmin[2], zero));
+			__m256 exit = _mm256_min_ps(_mm256_min_ps(tmax[0], tmax[1]), _mm256_min_ps(tmax[2], _mm256_loadu_ps(&distances[i])));
+			result |= uint64_t(_mm256_movemask_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ))) << i;
+		}
+
+		// The tail runs on SSE instructions, which stall on the upper halves of the wide registers unless they are cleared first.
+		_mm256_zeroupper();
+		return (result & mask) | hit_sse(packet, bounds, mask, distances, i);
+	}
+#endif
+
+	uint64_t raypacket_t::hit(const bounds_t& bounds, const uint64_t mask, const float* distances) const
+	{
+		switch (simdlevel())
+		{
+#if defined(RAYTRACER_AVX2)
+		case SIMDTYPE_AVX2:
+			return hit_avx2(*this, bounds, mask, distances, 0);
+#endif
+#if defined(RAYTRACER_SSE)
+		case SIMDTYPE_SSE:
+			return hit_sse(*this, bounds, mask, distances, 0);
+#endif
+		default:
+			return hit_scalar(*this, bounds, mask, distances, 0);
+		}
+	}
+
+	void bvh_t::clear()
+	{
+		this->_nodes.clear();
+		this->_indices.clear();
+	}
+
+	bool bvh_t::split(std::vector<reference_t>& references, const range_t& range, threadpool_t* pool, range_t& left, range_t& right, int& axis)
+	{
+		size_t count = range.count();
+		if (count <= 1)
+		{
+			return false;
+		}
+
+		size_t levels = 0;
+		for (size_t n = count; n > maxleaf; n = (n + 1) / 2)
+		{
+			levels++;
+		}
+
+		axis = -1;
+		size_t split = 0;
+		bool binned = false;
+		reference_t* first = &references[range._begin];
+		left._box = right._box = left._spread = right._spread = bounds_t();
+		if (range._depth + levels + 1 < maxdepth)
+		{
+			glm::vec3 scale(0.0f);
+			for (int a = 0; a < 3; a++)
+			{
+				float extent = range._spread._max[a] - range._spread._min[a];
+				scale[a] = extent > 0.0f && float(binsize) / extent < FLT_MAX ? float(binsize) / extent : 0.0f;
+			}
+
+			float best = FLT_MAX;
+			float areas[binsize];
+			if (count <= binsize)
+			{
+				// Small ranges are swept exactly, every gap between two sorted centers is a candidate split.
+				int sorted = -1;
+				for (int a = 0; a < 3; a++)
+				{
+					if (scale[a] <= 0.0f)
+					{
+						continue;
+					}
+
+					std::sort(first, first + count, centerorder_t(a));
+					sorted = a;
+					bounds_t accumulate;
+					for (size_t i = count - 1; i > 0; i--)
+					{
+						accumulate.expand(first[i]._box);
+						areas[i] = accumulate.area();
+					}
+
+					accumulate = bounds_t();
+					for (size_t i = 1; i < count; i++)
+					{
+						accumulate.expand(first[i - 1]._box);
+						float cost = (accumulate.area() * float(i)) + (areas[i] * float(count - i));
+						if (cost < best)
+						{
+							best = cost;
+							axis = a;
+							split = i;
+						}
+					}
+				}
+
+				if (axis >= 0 && axis != sorted)
+				{
+					std::sort(first, first + count, centerorder_t(axis));
+				}
+			}
+			else
+			{
+				bvhbin_t bins[3 * binsize];
+				if (pool != 0 && count >= parallelbins)
+				{
+					// Each chunk fills its own bins, which are merged afterwards in chunk order.
+					size_t chunks = pool->size() * 4;
+					std::vector<bvhbin_t> partial(chunks * 3 * binsize);
+					pool->dispatch(chunks, [first, &range, &scale, &partial, chunks, count](const size_t index, const size_t worker)
+					{
+						size_t begin = (count * index) / chunks;
+						fillbins(first + begin, ((count * (index + 1)) / chunks) - begin, range._spread, scale, &partial[index * 3 * binsize]);
+					});
+
+					for (size_t i = 0; i < partial.size(); i++)
+					{
+						bvhbin_t& bin = bins[i % (3 * binsize)];
+						bin._box.expand(partial[i]._box);
+						bin._spread.expand(partial[i]._spread);
+						bin._count += partial[i]._count;
+					}
+				}
+				else
+				{
+					fillbins(first, count, range._spread, scale, bins);
+				}
+
+				for (int a = 0; a < 3; a++)
+				{
+					if (scale[a] <= 0.0f)
+					{
+						continue;
+					}
+
+					const bvhbin_t* row = &bins[a * binsize];
+					bounds_t accumulate;
+					for (size_t i = binsize - 1; i > 0; i--)
+					{
+						accumulate.expand(row[i]._box);
+						areas[i] = accumulate.area();
+					}
+
+					accumulate = bounds_t();
+					size_t before = 0;
+					for (size_t i = 1; i < binsize; i++)
+					{
+						accumulate.expand(row[i - 1]._box);
+						before += row[i - 1]._count;
+						if (before == 0 || before == count)
+						{
+							continue;
+						}
+
+						float cost = (accumulate.area() * float(before)) + (areas[i] * float(count - before));
+						if (cost < best)
+						{
+							best = cost;
+							axis = a;
+							split = i;
+						}
+					}
+				}
+
+				if (axis >= 0)
+				{
+					const bvhbin_t* row = &bins[axis * binsize];
+					for (size_t i = 0; i < binsize; i++)
+					{
+						range_t& child = i < split ? left : right;
+						child._box.expand(row[i]._box);
+						child._spread.expand(row[i]._spread);
+					}
+
+					split = size_t(std::partition(first, first + count, binorder_t(axis, range._spread._min[axis], scale[axis], split)) - first);
+					binned = true;
+				}
+			}
+
+			if (axis >= 0)
+			{
+				float area = range._box.area();
+				float cost = traversalcost + (area > 0.0f ? best / area : float(count));
+				if (count <= maxleaf && cost >= float(count))
+				{
+					return false;
+				}
+			}
+		}
+
+		if (axis < 0)
+		{
+			if (count <= maxleaf)
+			{
+				return false;
+			}
+
+			// Flat or too deep to split by cost, so the range is halved at its median on the widest axis of its centers.
+			axis = range._spread.axis();
+			split = count / 2;
+			std::nth_element(first, first + split, first + count, centerorder_t(axis));
+		}
+
+		if (!binned)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				range_t& child = i < split ? left : right;
+				child._box.expand(first[i]._box);
+				child._spread.expand(first[i]._center);
+			}
+		}
+
+		left._begin = range._begin;
+		left._end = right._begin = range._begin + split;
+		right._end = range._end;
+		left._depth = right._depth = range._depth + 1;
+		return true;
+	}
+
+	uint32_t bvh_t::build(std::vector<bvhnode_t>& nodes, std::vector<reference_t>& references, const range_t& range)
+	{
+		uint32_t index = (uint32_t)nodes.size();
+		nodes.push_back(bvhnode_t());
+		nodes[index]._bounds = range._box;
+		range_t left;
+		range_t right;
+		int axis = 0;
+		if (!this->split(references, range, 0, left, right, axis))
+		{
+			nodes[index]._offset = (uint32_t)range._begin;
+			nodes[index]._count = (uint16_t)range.count();
+			return index;
+		}
+
+		this->build(nodes, references, left);
+		uint32_t second = this->build(nodes, references, right);
+		nodes[index]._offset = second;
+		nodes[index]._axis = (uint16_t)axis;
+		return index;
+	}
+
+	uint32_t bvh_t::plan(std::vector<bvhnode_t>& nodes, std::vector<uint32_t>& owners, std::vector<range_t>& subtrees, std::vector<reference_t>& references, const range_t& range, const size_t grain, threadpool_t& pool)
+	{
+		uint32_t index = (uint32_t)nodes.size();
+		nodes.push_back(bvhnode_t());
+		owners.push_back(nosubtree);
+		nodes[index]._bounds = range._box;
+		range_t left;
+		range_t right;
+		int axis = 0;
+		if (range.count() <= grain)
+		{
+			owners[index] = (uint32_t)subtrees.size();
+			subtrees.push_back(range);
+			return index;
+		}
+
+		if (!this->split(references, range, &pool, left, right, axis))
+		{
+			nodes[index]._offset = (uint32_t)range._begin;
+			nodes[index]._count = (uint16_t)range.count();
+			return index;
+		}
+
+		this->plan(nodes, owners, subtrees, references, left, grain, pool);
+		uint32_t second = this->plan(nodes, owners, subtrees, references, right, grain, pool);
+		nodes[index]._offset = second;
+		nodes[index]._axis = (uint16_t)axis;
+		return index;
+	}
+
+	bool bvh_t::split(const std::vector<uint64_t>& codes, const range_t& range, range_t& left, range_t& right, int& axis) const
+	{
+		size_t count = range.count();
+		if (count <= linearleaf)
+		{
+			return false;
+		}
+
+		size_t levels = 0;
+		for (size_t n = count; n > linearleaf; n = (n + 1) / 2)
+		{
+			levels++;
+		}
+
+		// The codes interleave the axes from x down to z, so the highest bit they differ in also tells which axis the split is on.
+		uint64_t first = codes[range._begin];
+		uint64_t last = codes[range._end - 1];
+		size_t split = count / 2;
+		axis = 0;
+		if (first != last)
+		{
+			int bit = highestbit(first ^ last);
+			axis = 2 - (bit % 3);
+			if (range._depth + levels + 1 < maxdepth)
+			{
+				std::vector<uint64_t>::const_iterator begin = codes.begin() + range._begin;
+				split = size_t(std::upper_bound(begin, codes.begin() + range._end, first | ((uint64_t(1) << bit) - 1)) - begin);
+			}
+		}
+
+		left = range_t();
+		right = range_t();
+		left._begin = range._begin;
+		left._end = right._begin = range._begin + split;
+		right._end = range._end;
+		left._depth = right._depth = range._depth + 1;
+		return true;
+	}
+
+	uint32_t bvh_t::build(std::vector<bvhnode_t>& nodes, const std::vector<bounds_t>& bounds, const std::vector<uint64_t>& codes, const range_t& range)
+	{
+		uint32_t index = (uint32_t)nodes.size();
+		nodes.push_back(bvhnode_t());
+		range_t left;
+		range_t right;
+		int axis = 0;
+		if (!this->split(codes, range, left, right, axis))
+		{
+			bounds_t box;
+			for (size_t i = range._begin; i < range._end; i++)
+			{
+				box.expand(bounds[this->_indices[i]]);
+			}
+
+			nodes[index]._bounds = box;
+			nodes[index]._offset = (uint32_t)range._begin;
+			nodes[index]._count = (uint16_t)range.count();
+			return index;
+		}
+
+		this->build(nodes, bounds, codes, left);
+		uint32_t second = this->build(nodes, bounds, codes, right);
+		bounds_t box = nodes[index + 1]._bounds;
+		box.expand(nodes[second]._bounds);
+		nodes[index]._bounds = box;
+		nodes[index]._offset = second;
+		nodes[index]._axis = (uint16_t)axis;
+		return index;
+	}
+
+	uint32_t bvh_t::plan(std::vector<bvhnode_t>& nodes, std::vector<uint32_t>& owners, std::vector<range_t>& subtrees, const std::vector<uint64_t>& codes, const range_t& range, const size_t grain)
+	{
+		uint32_t index = (uint32_t)nodes.size();
+		nodes.push_back(bvhnode_t());
+		owners.push_back(nosubtree);
+		range_t left;
+		range_t right;
+		int axis = 0;
+		if (range.count() <= grain || !this->split(codes, range, left, right, axis))
+		{
+			owners[index] = (uint32_t)subtrees.size();
+			subtrees.push_back(range);
+			return index;
+		}
+
+		this->plan(nodes, owners, subtrees, codes, left, grain);
+		uint32_t second = this->plan(nodes, owners, subtrees, codes, right, grain);
+		nodes[index]._offset = second;
+		nodes[index]._axis = (uint16_t)axis;
+		return index;
+	}
+
+	void bvh_t::splice(const std::vector<bvhnode_t>& nodes, const std::vector<uint32_t>& owners, std::vector<range_t>& subtrees, const uint32_t index)
+	{
+		if (owners[index] != nosubtree)
+		{
+			std::vector<bvhnode_t>& subtree = subtrees[owners[index]]._nodes;
+			uint32_t base = (uint32_t)this->_nodes.size();
+			for (std::vector<bvhnode_t>::iterator i = subtree.begin(); i != subtree.end(); i++)
+			{
+				this->_nodes.push_back(*i);
+				if (!i->leaf())
+				{
+					this->_nodes.back()._offset += base;
+				}
+			}
+
+			std::vector<bvhnode_t>().swap(subtree);
+			return;
+		}
+
+		uint32_t at = (uint32_t)this->_nodes.size();
+		this->_nodes.push_back(nodes[index]);
+		if (!nodes[index].leaf())
+		{
+			this->splice(nodes, owners, subtrees, index + 1);
+			uint32_t second = (uint32_t)this->_nodes.size();
+			this->splice(nodes, owners, subtrees, nodes[index]._offset);
+			bounds_t box = this->_nodes[at + 1]._bounds;
+			box.expand(this->_nodes[second]._bounds);
+			this->_nodes[at]._bounds = box;
+			this->_nodes[at]._offset = second;
+		}
+	}
+
+}
\ No newline at end of file
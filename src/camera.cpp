@@ -13,5 +13,22 @@ namespace ray
 		glm::vec3 origin = this->_p0 + (this->_u * u) + (this->_v * v);
 		return ray_t(origin, glm::normalize(origin - this->_focal));
 	}
+	ray_t camera_t::cast(const glm::vec2& coord, const glm::vec2& pixel) const
+	{
+		glm::vec3 origin = this->_p0 + (this->_u * coord.x) + (this->_v * coord.y);
+		glm::vec3 direction = origin - this->_focal;
+		glm::vec3 dodx = this->_u * pixel.x;
+		glm::vec3 dody = this->_v * pixel.y;
+		float length2 = glm::dot(direction, direction);
+		float length3 = length2 * sqrt(length2);
+		return ray_t(
+			origin,
+			glm::normalize(direction),
+			raydifferential_t(
+				dodx,
+				dody,
+				((dodx * length2) - (direction * glm::dot(direction, dodx))) / length3,
+				((dody * length2) - (direction * glm::dot(direction, dody))) / length3));
+	}
 	
 }
\ No newline at end of file
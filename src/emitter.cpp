@@ -1,93 +1,487 @@
-
 #include "../include/RayTracer.h"
 
 namespace ray
 {
 
-#if 0
-	bool photo_t::empty() const
+	const size_t emitter_t::maxpacket;
+
+	/// <summary>
+	/// Throughput below which paths are stopped by russian roulette instead of always continuing.
+	/// </summary>
+	static const float roulette = 0.1f;
+	
+
+	/// <summary>
+	/// Smallest cosine between the normals of neighbouring pixels that are not on an edge.
+	/// </summary>
+	static const float edgefacing = 0.95f;
+	
+	/// <summary>
+	/// Largest difference in any color channel between neighbouring pixels that are not on an edge.
+	/// </summary>
+	static const float edgecontrast = 0.1f;
+	
+	/// <summary>
+	/// Fewest samples a pixel needs before its variance is trusted to stop sampling it.
+	/// </summary>
+	static const uint32_t convergesamples = 8;
+
+	void emitter_t::emit(const scene_t& scene, photo_t& photo, const preview_t& preview) const
 	{
-		return this->_buffer == 0 || this->_width < 1 || this->_height < 1;
+		photo.resize(std::max(scene._photo.x, 1), std::max(scene._photo.y, 1));
+		std::vector<tile_t> tiles = photo.tiles(this->_tileSize);
+		threadpool_t pool(this->_threads);
+		printf("tracing %dx%d, %d tiles on %d threads\n", (int)photo.width(), (int)photo.height(), (int)tiles.size(), (int)pool.size());
+		std::vector<patharena_t> arenas(pool.size());
+		std::vector<gbuffer_t> gbuffers(this->_shading != SHADINGTYPE_FORWARD ? pool.size() : 0);
+		std::vector<workerstats_t> stats(pool.size());
+		double busy = 0.0;
+		std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point shown = began;
+		
+		// Passes past the progressive sample count that are still within the multisample count only add samples to the pixels
+		// that need them, every pixel when sampling isn't adaptive and only the pixels on an edge when it is.
+		progress_t limits = this->_progress;
+		size_t multisample = this->multisample();
+		if (limits._samples != 0)
+		{
+			limits._samples = std::max(limits._samples, multisample);
+		}
+		
+		std::vector<uint8_t> edges;
+		std::vector<uint8_t> noisy;
+		std::vector<size_t> queued;
+		size_t sample = 0;
+		for (bool more = true; more; )
+		{
+			const uint8_t* active = 0;
+			if (this->_progress._samples != 0 && sample >= this->_progress._samples && (this->_multiSample & 0x00f0) == MULTISAMPLETYPE_EDGE)
+			{
+				if (edges.empty())
+				{
+					edges = photo.edges(edgefacing, edgecontrast);
+					printf("  %d pixels on edges\n", (int)std::count(edges.begin(), edges.end(), uint8_t(1)));
+				}
+				
+				active = &edges[0];
+			}
+			
+			// Pixels whose error has fallen under the threshold stop getting samples, so the passes after it only trace the noisy ones.
+			// Edge passes never get this far, they end with the multisample count, which is at most as many samples as this waits for.
+			if (this->_progress._threshold > 0.0f && sample >= convergesamples)
+			{
+				noisy = photo.noisy(this->_progress._threshold, convergesamples);
+				if (std::find(noisy.begin(), noisy.end(), uint8_t(1)) == noisy.end())
+				{
+					printf("  every pixel converged after %d passes\n", (int)sample);
+					break;
+				}
+				
+				active = &noisy[0];
+			}
+			
+			// Tiles without any pixel to sample are left out of the pass, so the threads spend it on the tiles that are still noisy.
+			queued.clear();
+			for (size_t i = 0; i < tiles.size(); i++)
+			{
+				bool any = active == 0;
+				for (int y = tiles[i]._p0.y; !any && y < tiles[i]._p1.y; y++)
+				{
+					const uint8_t* row = active + (y * photo.width());
+					any = std::find(row + tiles[i]._p0.x, row + tiles[i]._p1.x, uint8_t(1)) != row + tiles[i]._p1.x;
+				}
+				
+				if (any)
+				{
+					queued.push_back(i);
+				}
+			}
+			
+			pool.dispatch(queued.size(), [this, &scene, &tiles, &queued, &photo, &arenas, &gbuffers, sample, active](const size_t index, const size_t worker)
+			{
+				const tile_t& tile = tiles[queued[index]];
+				if (this->_shading == SHADINGTYPE_WAVEFRONT)
+				{
+					this->stream(scene, tile, photo, gbuffers[worker], sample, active);
+				}
+				else if (this->_shading == SHADINGTYPE_DEFERRED)
+				{
+					this->defer(scene, tile, photo, arenas[worker], gbuffers[worker], sample, active);
+				}
+				else
+				{
+					this->trace(scene, tile, photo, arenas[worker], sample, active);
+				}
+			});
+			
+			sample++;
+			busy += queued.empty() ? 0.0 : pool.elapsed();
+			for (size_t i = 0; i < stats.size() && !queued.empty(); i++)
+			{
+				stats[i]._tasks += pool.stats()[i]._tasks;
+				stats[i]._steals += pool.stats()[i]._steals;
+				stats[i]._busy += pool.stats()[i]._busy;
+			}
+			
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			more = limits.more(sample, std::chrono::duration<double>(now - began).count());
+			if (more && preview && this->_progress._interval > 0.0 && std::chrono::duration<double>(now - shown).count() >= this->_progress._interval)
+			{
+				preview(photo, sample);
+				shown = now;
+			}
+		}
+		
+		size_t total = 0;
+		for (size_t i = 0; i < photo.height(); i++)
+		{
+			for (size_t k = 0; k < photo.width(); k++)
+			{
+				total += photo.samples(glm::ivec2(k, i));
+			}
+		}
+		
+		printf("traced %d passes, %.2f samples per pixel on average\n", (int)sample, double(total) / double(photo.width() * photo.height()));
+		for (size_t i = 0; i < stats.size(); i++)
+		{
+			const arenastats_t& arena = arenas[i].stats();
+			printf("  worker %d: %d tiles, %d stolen, %.1f%% busy, %d path links, %d arena chunks\n", (int)i, (int)stats[i]._tasks, (int)stats[i]._steals, stats[i].utilization(busy) * 100.0, (int)arena._nodes, (int)arena._chunks);
+		}
 	}
 
-	void photo_t::resize(const size_t width, const size_t height)
+	void emitter_t::trace(const scene_t& scene, const tile_t& tile, photo_t& photo, patharena_t& arena, const size_t sample, const uint8_t* active) const
 	{
-		tracepath_t* old = this->_buffer;
-		size_t oldWidth = this->_width;
-		size_t oldHeight = this->_height;
-		this->_width = std::max(width, (size_t)1ul);
-		this->_height = std::max(height, (size_t)1ul);
-		this->_buffer = (tracepath_t*)calloc(this->_width * this->_height, sizeof(tracepath_t));
-		if (old != 0)
+		arena.reset();
+		ray_t rays[maxpacket * maxpacket];
+		hitrecord_t records[maxpacket * maxpacket];
+		glm::ivec2 pixels[maxpacket * maxpacket];
+		int side = int(this->_packetSize);
+		for (int y = tile._p0.y; y < tile._p1.y; y += side)
 		{
-			for (size_t i = 0; i < oldHeight && i < this->_height; i++)
+			for (int x = tile._p0.x; x < tile._p1.x; x += side)
 			{
-				memcpy(this->_buffer + (this->_width * i), old + (oldWidth * i), std::min(oldWidth, this->_width) * sizeof(tracepath_t));
+				tile_t block(glm::ivec2(x, y), glm::min(glm::ivec2(x + side, y + side), tile._p1));
+				size_t count = this->cast(scene, block, photo, sample, active, rays, records, pixels);
+				for (size_t i = 0; i < count; i++)
+				{
+					glm::vec3 normal(0.0f);
+					photo.accumulate(pixels[i], this->trace(scene, rays[i], records[i], arena, this->sampler(photo, pixels[i], sample), normal));
+					if (sample == 0 && !records[i].empty())
+					{
+						photo.surface(pixels[i], records[i]._id, normal);
+					}
+				}
 			}
-			
-			free(old);
 		}
 	}
-	void photo_t::release()
+
+	void emitter_t::defer(const scene_t& scene, const tile_t& tile, photo_t& photo, patharena_t& arena, gbuffer_t& gbuffer, const size_t sample, const uint8_t* active) const
 	{
-		if (this->_buffer != 0)
+		arena.reset();
+		ray_t rays[maxpacket * maxpacket];
+		hitrecord_t records[maxpacket * maxpacket];
+		glm::ivec2 pixels[maxpacket * maxpacket];
+		int width = tile._p1.x - tile._p0.x;
+		int side = int(this->_packetSize);
+		gbuffer._rays.resize(tile.area());
+		gbuffer._entries.clear();
+		for (int y = tile._p0.y; y < tile._p1.y; y += side)
 		{
-			free(this->_buffer);
+			for (int x = tile._p0.x; x < tile._p1.x; x += side)
+			{
+				tile_t block(glm::ivec2(x, y), glm::min(glm::ivec2(x + side, y + side), tile._p1));
+				size_t count = this->cast(scene, block, photo, sample, active, rays, records, pixels);
+				for (size_t i = 0; i < count; i++)
+				{
+					const glm::ivec2& pixel = pixels[i];
+					gbuffer_t::entry_t entry;
+					entry._pixel = uint32_t(((pixel.y - tile._p0.y) * width) + (pixel.x - tile._p0.x));
+					gbuffer._rays[entry._pixel] = rays[i];
+					if (!records[i].empty())
+					{
+						entry._record = records[i];
+						entry._material = scene._stack.material(entry._record._id);
+						gbuffer._entries.push_back(entry);
+					}
+					else
+					{
+						photo.accumulate(pixel, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+					}
+				}
+			}
 		}
 		
-		this->_buffer = 0;
-		this->_width = 0;
-		this->_height = 0;
+		this->shade(scene, &gbuffer._rays[0], gbuffer);
+		for (size_t i = 0; i < gbuffer._entries.size(); i++)
+		{
+			const gbuffer_t::entry_t& entry = gbuffer._entries[i];
+			glm::ivec2 pixel(tile._p0.x + int(entry._pixel % width), tile._p0.y + int(entry._pixel / width));
+			pathstate_t state(this->sampler(photo, pixel, sample));
+			ray_t ray = gbuffer._rays[entry._pixel];
+			if (sample == 0)
+			{
+				photo.surface(pixel, entry._record._id, gbuffer._fragments[i]._normal);
+			}
+			
+			if (this->scatter(arena.allocate(gbuffer._fragments[i], scene._stack), gbuffer._luminations[i], state, ray))
+			{
+				this->follow(scene, ray, arena, state);
+			}
+			
+			photo.accumulate(pixel, state._lumination.flatten());
+		}
 	}
-	
-	void photo_t::trace(const tracestack_t& stack, const camera_t& camera)
+
+	void emitter_t::stream(const scene_t& scene, const tile_t& tile, photo_t& photo, gbuffer_t& gbuffer, const size_t sample, const uint8_t* active) const
 	{
-		for (size_t i = 0; i < this->_height; i++)
+		int width = tile._p1.x - tile._p0.x;
+		int side = int(this->_packetSize);
+		gbuffer._queue.clear();
+		gbuffer._gathered.assign(tile.area(), lumination_t(0.0f, 0.0f));
+		
+		// Camera rays are queued block by block, so the rays next to each other in the queue are traced as packets.
+		for (int y = tile._p0.y; y < tile._p1.y; y += side)
 		{
-			for (size_t k = 0; k < this->_width; k++)
+			for (int x = tile._p0.x; x < tile._p1.x; x += side)
 			{
-				ray_t ray = camera.cast(float(k) / float(this->_width), float(i) / float(this->_height));
-				rayhit_t hit;
-				const traceable_t* obj = stack.nearest(ray, &hit);
-				if (obj != 0)
+				for (int i = y; i < std::min(y + side, tile._p1.y); i++)
 				{
-					tracepath_t* path = &(this->operator[](glm::ivec2(k, i)));
-					*path = tracepath_t(obj->fragmentate(hit), stack, 0, 0);
+					for (int k = x; k < std::min(x + side, tile._p1.x); k++)
+					{
+						if (active != 0 && active[(i * photo.width()) + k] == 0)
+						{
+							continue;
+						}
+						
+						gbuffer._queue.push_back(this->cast(scene, photo, glm::ivec2(k, i), sample), uint32_t(((i - tile._p0.y) * width) + (k - tile._p0.x)), 1.0f);
+					}
 				}
 			}
 		}
+		
+		for (size_t depth = 0; gbuffer._queue.size() > 0; depth++)
+		{
+			rayqueue_t& queue = gbuffer._queue;
+			queue._records.assign(queue.size(), hitrecord_t());
+			if (depth == 0 && side > 1)
+			{
+				scene._stack.intersect(&queue._rays[0], queue.size(), &queue._records[0]);
+			}
+			else
+			{
+				// Scattered rays go off in every direction, so they walk the hierarchy one at a time.
+				for (size_t i = 0; i < queue.size(); i++)
+				{
+					scene._stack.intersect(queue._rays[i], queue._records[i]);
+				}
+			}
+			
+			gbuffer._entries.clear();
+			for (size_t i = 0; i < queue.size(); i++)
+			{
+				if (!queue._records[i].empty())
+				{
+					gbuffer_t::entry_t entry;
+					entry._pixel = uint32_t(i);
+					entry._record = queue._records[i];
+					entry._material = scene._stack.material(entry._record._id);
+					gbuffer._entries.push_back(entry);
+				}
+			}
+			
+			if (!gbuffer._entries.empty())
+			{
+				this->shade(scene, &queue._rays[0], gbuffer);
+			}
+			
+			gbuffer._next.clear();
+			for (size_t i = 0; i < gbuffer._entries.size(); i++)
+			{
+				uint32_t index = gbuffer._entries[i]._pixel;
+				uint32_t pixel = queue._pixels[index];
+				glm::ivec2 coord(tile._p0.x + int(pixel % width), tile._p0.y + int(pixel / width));
+				pathstate_t state(this->sampler(photo, coord, sample));
+				state._lumination = gbuffer._gathered[pixel];
+				state._throughput = queue._throughputs[index];
+				state._depth = depth;
+				ray_t ray = queue._rays[index];
+				if (depth == 0 && sample == 0)
+				{
+					photo.surface(coord, gbuffer._entries[i]._record._id, gbuffer._fragments[i]._normal);
+				}
+				
+				if (this->scatter(gbuffer._fragments[i], gbuffer._luminations[i], state, ray))
+				{
+					gbuffer._next.push_back(ray, pixel, state._throughput);
+				}
+				
+				gbuffer._gathered[pixel] = state._lumination;
+			}
+			
+			std::swap(gbuffer._queue, gbuffer._next);
+		}
+		
+		for (size_t i = 0; i < tile.area(); i++)
+		{
+			glm::ivec2 pixel(tile._p0.x + int(i % width), tile._p0.y + int(i / width));
+			if (active == 0 || active[(pixel.y * photo.width()) + pixel.x] != 0)
+			{
+				photo.accumulate(pixel, gbuffer._gathered[i].flatten());
+			}
+		}
 	}
 
-	IMAGETYPE* photo_t::rasterize() const
+	void emitter_t::shade(const scene_t& scene, const ray_t* rays, gbuffer_t& gbuffer) const
 	{
-		FIBITMAP* bitmap = FreeImage_Allocate(this->_width, this->_height, 32);
-		if (!this->empty())
+		// Fragments are rebuilt in material order, so each material's textures are read together.
+		std::sort(gbuffer._entries.begin(), gbuffer._entries.end());
+		gbuffer._fragments.clear();
+		gbuffer._luminations.assign(gbuffer._entries.size(), lumination_t(0.0f, 0.0f));
+		for (size_t i = 0; i < gbuffer._entries.size(); i++)
 		{
-			for (size_t i = 0; i < this->_height; i++)
+			const gbuffer_t::entry_t& entry = gbuffer._entries[i];
+			gbuffer._fragments.push_back(scene._stack.fragmentate(rays[entry._pixel], entry._record));
+		}
+		
+		for (size_t begin = 0; begin < gbuffer._entries.size(); )
+		{
+			size_t end = begin + 1;
+			while (end < gbuffer._entries.size() && gbuffer._entries[end]._material == gbuffer._entries[begin]._material)
+			{
+				end++;
+			}
+			
+			scene._stack.illuminate(gbuffer._entries[begin]._material, &gbuffer._fragments[begin], end - begin, &gbuffer._luminations[begin], gbuffer._lighting, gbuffer._indices, gbuffer._batch, this->_packetSize * this->_packetSize);
+			begin = end;
+		}
+	}
+
+	ray_t emitter_t::cast(const scene_t& scene, const photo_t& photo, const glm::ivec2& pixel, const size_t sample) const
+	{
+		// When more than one sample per pixel may be traced every sample, the first included, is spread over the pixel by the first pair of dimensions,
+		// so any first samples of a pixel stay stratified. A photo of a single sample per pixel traces it through the center.
+		glm::vec2 offset = this->jittered() ? this->sampler(photo, pixel, sample).get(0) : glm::vec2(0.5f);
+		
+		glm::vec2 size(float(photo.width()), float(photo.height()));
+		return scene._camera.cast((glm::vec2(pixel) + offset) / size, 1.0f / size);
+	}
+
+	size_t emitter_t::cast(const scene_t& scene, const tile_t& block, const photo_t& photo, const size_t sample, const uint8_t* active, ray_t* rays, hitrecord_t* records, glm::ivec2* pixels) const
+	{
+		size_t count = 0;
+		for (int i = block._p0.y; i < block._p1.y; i++)
+		{
+			for (int k = block._p0.x; k < block._p1.x; k++)
 			{
-				for (size_t k = 0; k < this->_width; k++)
+				if (active == 0 || active[(i * photo.width()) + k] != 0)
 				{
-					tracepath_t* path = &(this->operator[](glm::ivec2(k, i)));
-					lumination_t albedo = path->albedo();
-					glm::vec4 color = albedo.flatten();
-					RGBQUAD pixel = {
-						(uint8_t)(color.b * 255.0f),
-						(uint8_t)(color.g * 255.0f),
-						(uint8_t)(color.r * 255.0f),
-						(uint8_t)(color.a * 255.0f)
-					};
-					FreeImage_SetPixelColor(bitmap, k, i, &pixel);
+					pixels[count] = glm::ivec2(k, i);
+					rays[count] = this->cast(scene, photo, pixels[count], sample);
+					count++;
 				}
 			}
 		}
 		
-		return bitmap;
+		if (count > 1)
+		{
+			scene._stack.intersect(rays, count, records);
+		}
+		else if (count == 1)
+		{
+			records[0] = hitrecord_t();
+			scene._stack.intersect(rays[0], records[0]);
+		}
+		
+		return count;
 	}
 
-	tracepath_t& photo_t::operator[](const glm::ivec2& coord) const
+	sampler_t emitter_t::sampler(const photo_t& photo, const glm::ivec2& pixel, const size_t sample) const
 	{
-		return this->_buffer[((coord.y % this->_height) * this->_width) + (coord.x % this->_width)];
+		return sampler_t(uint32_t((pixel.y * photo.width()) + pixel.x), uint32_t(sample), this->_frame);
+	}
+
+	glm::vec4 emitter_t::trace(const scene_t& scene, const ray_t& ray, const hitrecord_t& record, patharena_t& arena, const sampler_t& sampler, glm::vec3& normal) const
+	{
+		pathstate_t state(sampler);
+		ray_t next = ray;
+		if (!record.empty())
+		{
+			tracepath_t* path = arena.allocate(scene._stack.fragmentate(ray, record), scene._stack);
+			normal = path->fragment()._normal;
+			if (this->scatter(path, path->albedo(), state, next))
+			{
+				this->follow(scene, next, arena, state);
+			}
+		}
+		
+		return state._lumination.flatten();
+	}
+	
+	void emitter_t::follow(const scene_t& scene, ray_t ray, patharena_t& arena, pathstate_t& state) const
+	{
+		for (;;)
+		{
+			hitrecord_t record;
+			if (!scene._stack.intersect(ray, record))
+			{
+				break;
+			}
+			
+			tracepath_t* path = arena.allocate(scene._stack.fragmentate(ray, record), scene._stack);
+			if (!this->scatter(path, path->albedo(), state, ray))
+			{
+				break;
+			}
+		}
+	}
+	
+	bool emitter_t::scatter(tracepath_t* path, const lumination_t& lumination, pathstate_t& state, ray_t& ray) const
+	{
+		if (state._previous != 0)
+		{
+			state._previous->link(state._reflected ? path : 0, state._reflected ? 0 : path);
+		}
+		
+		if (!this->scatter(path->fragment(), lumination, state, ray))
+		{
+			return false;
+		}
+		
+		state._previous = path;
+		return true;
+	}
+	
+	bool emitter_t::scatter(const fragment_t& fragment, const lumination_t& lumination, pathstate_t& state, ray_t& ray) const
+	{
+		float reflectivity = glm::clamp(fragment._reflectivity, 0.0f, 1.0f);
+		float transparency = glm::clamp(fragment._transparency, 0.0f, 1.0f - reflectivity);
+		float scatter = reflectivity + transparency;
+		size_t depth = state._depth++;
+		bool last = depth >= this->_reflectDepth || scatter <= 0.0f;
+		state._lumination += lumination * (state._throughput * (last ? 1.0f : 1.0f - scatter));
+		if (last)
+		{
+			return false;
+		}
+		
+		// Each bounce draws its two choices from its own pair of dimensions, the first pair places the sample inside of the pixel.
+		glm::vec2 u = state._sampler.get(uint32_t(depth + 1));
+		state._throughput *= scatter;
+		float survival = std::min(state._throughput / roulette, 1.0f);
+		if (survival < 1.0f)
+		{
+			if (u.x >= survival)
+			{
+				return false;
+			}
+			
+			state._throughput /= survival;
+		}
+		
+		// Picks one of the two directions by its share of the scatter, which the throughput already accounts for.
+		state._reflected = u.y * scatter < reflectivity;
+		ray = state._reflected ? fragment.reflect(ray) : fragment.passthrough(ray);
+		return true;
 	}
-#endif
 
 }
\ No newline at end of file
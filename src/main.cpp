@@ -106,6 +106,37 @@ void ensureprefs()
 			file << "# tracer photo\n";
 			file << "photo_x = 240\n";
 			file << "photo_y = 160\n";
+			file << "\n";
+			file << "# tracer threads, 0 uses every core\n";
+			file << "threads = 0\n";
+			file << "tile = 32\n";
+			file << "\n";
+			file << "# acceleration structure (sah, lbvh, none) for scenes that do not pick one, lbvh builds much faster but traces slower\n";
+			file << "bvh = sah\n";
+			file << "\n";
+			file << "# reflection and passthrough bounces per path\n";
+			file << "depth = 4\n";
+			file << "\n";
+			file << "# shading (forward, deferred, wavefront), deferred shades each tile's hits in batches of the same material, wavefront traces every bounce that way\n";
+			file << "shading = forward\n";
+			file << "\n";
+			file << "# width and height in pixels of the packets camera rays are traced in, 1 traces them one at a time\n";
+			file << "packet = 8\n";
+			file << "\n";
+			file << "# progressive passes, each adds a sample to every pixel until the sample count or the time budget in seconds is reached, 0 is no limit\n";
+			file << "samples = 1\n";
+			file << "budget = 0\n";
+			file << "# seconds between previews written while tracing, 0 writes none\n";
+			file << "interval = 0\n";
+			file << "# error in luminance under which a pixel stops getting samples after at least 8, 0 samples every pixel in every pass\n";
+			file << "threshold = 0\n";
+			file << "\n";
+			file << "# samples per pixel for antialiasing (single, quad, oct), adaptive only spends them on pixels along edges\n";
+			file << "multisample = single\n";
+			file << "adaptive = true\n";
+			file << "\n";
+			file << "# intersection kernels (scalar, sse, avx2), limited to what the processor supports\n";
+			file << "simd = avx2\n";
 		}
 		else
 		{
@@ -188,6 +219,17 @@ inline void cleanup()
 	FreeImage_DeInitialise();
 }
 
+inline void save(const photo_t& photo, const std::string& filename)
+{
+	FIBITMAP* bitmap = photo.rasterize();
+	if (!FreeImage_Save(FIF_PNG, bitmap, filename.c_str(), 0))
+	{
+		printf("Failed to write: %s\n", filename.c_str());
+	}
+	
+	FreeImage_Unload(bitmap);
+}
+
 inline void printmissing()
 {
 	printf("%s: missing file operand\n", commandname);
@@ -221,55 +263,123 @@ int main(int argc, char** argv)
 	// shape_init();
 	
 	atexit(cleanup);
-    // scan();
+    scan();
     
     std::string scenepath;
+    std::string targetpath;
     std::list<char> options;
     if (argc == 1)
     {
     	printmissing();
     	return 2;
     }
-	else if (argc == 2)
+    
+	for (int i = 1; i < argc; i++)
 	{
-		std::string arg = argv[1];
-		if (!arg.empty() && arg[0] == '-')
+		std::string arg = argv[i];
+		if (arg == "--help")
 		{
-			if (arg == "--help")
-			{
-				printhelp();
-				return 0;
-			}
-			else
-			{
-				printmissing();
-				return 2;
-			}
+			printhelp();
+			return 0;
 		}
-		
-		scenepath = arg;
-	}
-	else if (argc == 3)
-	{
-		std::string arg = argv[1];
-		if (!arg.empty() && arg[0] == '-')
+		else if (arg.compare(0, 10, "--threads=") == 0)
+		{
+			preferences["threads"] = arg.substr(10);
+		}
+		else if (arg.compare(0, 7, "--tile=") == 0)
+		{
+			preferences["tile"] = arg.substr(7);
+		}
+		else if (arg.compare(0, 7, "--simd=") == 0)
+		{
+			preferences["simd"] = arg.substr(7);
+		}
+		else if (arg.compare(0, 8, "--depth=") == 0)
+		{
+			preferences["depth"] = arg.substr(8);
+		}
+		else if (arg.compare(0, 6, "--bvh=") == 0)
+		{
+			preferences["bvh"] = arg.substr(6);
+		}
+		else if (arg.compare(0, 10, "--shading=") == 0)
+		{
+			preferences["shading"] = arg.substr(10);
+		}
+		else if (arg.compare(0, 9, "--packet=") == 0)
+		{
+			preferences["packet"] = arg.substr(9);
+		}
+		else if (arg.compare(0, 10, "--samples=") == 0)
+		{
+			preferences["samples"] = arg.substr(10);
+		}
+		else if (arg.compare(0, 9, "--budget=") == 0)
+		{
+			preferences["budget"] = arg.substr(9);
+		}
+		else if (arg.compare(0, 11, "--interval=") == 0)
+		{
+			preferences["interval"] = arg.substr(11);
+		}
+		else if (arg.compare(0, 12, "--threshold=") == 0)
+		{
+			preferences["threshold"] = arg.substr(12);
+		}
+		else if (arg.compare(0, 14, "--multisample=") == 0)
+		{
+			preferences["multisample"] = arg.substr(14);
+		}
+		else if (arg.compare(0, 11, "--adaptive=") == 0)
+		{
+			preferences["adaptive"] = arg.substr(11);
+		}
+		else if (arg.compare(0, 8, "--frame=") == 0)
+		{
+			preferences["frame"] = arg.substr(8);
+		}
+		else if (arg.size() > 1 && arg[0] == '-' && arg[1] != '-')
 		{
 			arg = arg.substr(1);
-			for (std::string::iterator i = arg.begin(); i != arg.end(); i++)
+			for (std::string::iterator k = arg.begin(); k != arg.end(); k++)
 			{
-				options.push_back(*i);
+				options.push_back(*k);
 			}
 		}
-		
-		scenepath = argv[2];
+		else if (!arg.empty() && arg[0] == '-')
+		{
+			printf("Invalid arguments\n");
+			return 2;
+		}
+		else if (scenepath.empty())
+		{
+			scenepath = arg;
+		}
+		else if (targetpath.empty())
+		{
+			targetpath = arg;
+		}
+		else
+		{
+			printf("Invalid arguments\n");
+			return 2;
+		}
+	}
+	
+	if (scenepath.empty())
+	{
+		printmissing();
+		return 2;
+	}
+	
+	if (targetpath.empty())
+	{
+		targetpath = workingdir();
 	}
-    else
-    {
-    	printf("Invalid arguments\n");
-    	return 2;
-    }
     
     scene_t s0;
+    if (preferences["bvh"] == "none") { s0._bvh = BVHTYPE_NONE; }
+    else if (preferences["bvh"] == "lbvh") { s0._bvh = BVHTYPE_LBVH; }
     read_scene(scenepath.c_str(), s0);
     
     // std::ifstream file(resolvefile("demo-scene.json").c_str(), std::ios::binary | std::ios::ate);
@@ -294,34 +404,41 @@ int main(int argc, char** argv)
     
     // free(buffer);
     
-	// photo_t photo(pref_i("photo_x"), pref_i("photo_y"));
-	
-	// FIBITMAP* uvgrid01 = FreeImage_Load(FIF_JPEG, resolvefile("uvgrid01.jpg").c_str(), JPEG_DEFAULT);
-	// FIBITMAP* uvgrid02 = FreeImage_Load(FIF_PNG, resolvefile("uvgrid02.png").c_str(), PNG_DEFAULT);
-	// lambert_t lambert0;
-	// lambert0.attach(texturefilter_t(uvgrid01, SAMPLETYPE_LINEAR), TEXTURETYPE_COLOR);
-	// blinn_t blinn0(48.0f);
-	// blinn0.attach(texturefilter_t(uvgrid02, SAMPLETYPE_LINEAR), TEXTURETYPE_COLOR);
-	
-	// tracestack_t stack;
-	
-	// tracesphere_t sphere0(vec4(0.0f, 0.0f, 0.0f, 1.0f), 2.4f);
-	// sphere0.attach(&blinn0);
-	// stack._traceables.push_back(&sphere0);
-	
-	// traceaxiscube_t cube0(vec4(3.0f, 0.0f, 0.0f, 1.0f), 4.0f, 4.0f, 4.0f);
-	// cube0.attach(&lambert0);
-	// stack._traceables.push_back(&cube0);
+	if (s0._photo.x < 1 || s0._photo.y < 1)
+	{
+		s0._photo = glm::ivec2(pref_i("photo_x"), pref_i("photo_y"));
+	}
 	
-	// stack._lights.push_back(new pointlight_t(vec4(0.4f, 1.0f, -3.0f, 1.0f), vec4(1.0f), 1.0f));
+	SIMDTYPE simd = simdsupport();
+	if (preferences["simd"] == "scalar") { simd = SIMDTYPE_SCALAR; }
+	else if (preferences["simd"] == "sse") { simd = SIMDTYPE_SSE; }
 	
-	// camera_t camera(shape_transformation(vec3(0.0f, 0.0f, -4.0f), vec3(1.0f), vec3(0.0f)), vec2(4.0f, 3.0f), 2.4f);
+	printf("simd: %s\n", simdname(simdlimit(simd)));
+	SHADINGTYPE shading = preferences["shading"] == "wavefront" ? SHADINGTYPE_WAVEFRONT : preferences["shading"] == "deferred" ? SHADINGTYPE_DEFERRED : SHADINGTYPE_FORWARD;
+	printf("shading: %s\n", shading == SHADINGTYPE_WAVEFRONT ? "wavefront" : shading == SHADINGTYPE_DEFERRED ? "deferred" : "forward");
+	int packet = preferences.count("packet") != 0 ? std::max(pref_i("packet"), 1) : 8;
+	progress_t progress(size_t(std::max(pref_i("samples"), 0)), pref_f("budget"), pref_f("interval"), float(pref_f("threshold")));
+	int multisample = preferences["multisample"] == "oct" ? MULTISAMPLETYPE_OCT : preferences["multisample"] == "quad" ? MULTISAMPLETYPE_QUAD : MULTISAMPLETYPE_SINGLE;
+	multisample |= preferences.count("adaptive") == 0 || pref_b("adaptive") ? MULTISAMPLETYPE_EDGE : MULTISAMPLETYPE_RANDOM;
+	emitter_t emitter(std::max(pref_i("depth"), 0), multisample, std::max(pref_i("threads"), 0), std::max(pref_i("tile"), 0), shading, packet, progress, uint32_t(std::max(pref_i("frame"), 0)));
+	printf("multisample: %d%s\n", (int)emitter.multisample(), (multisample & 0x00f0) == MULTISAMPLETYPE_EDGE ? " on edges" : "");
+	packet = std::min(packet, int(emitter_t::maxpacket));
+	printf("packets: %dx%d\n", packet, packet);
+	printf("samples: %d, budget: %.1f seconds, threshold: %.4f\n", (int)progress._samples, progress._seconds, progress._threshold);
 	
-	// photo.trace(stack, camera);
-	// FIBITMAP* bitmap = photo.rasterize();
-	// FreeImage_Save(FIF_PNG, bitmap, resolvefile("test.png").c_str(), 0);
-    
-    // photo.release();
+	std::string name = scenepath.substr(scenepath.find_last_of("/\\") + 1);
+	name = name.substr(0, name.find_last_of('.')) + ".png";
+	ensurefolder(targetpath);
+	std::string filename = resolvepath(targetpath, name);
+	photo_t photo;
+	std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+	emitter.emit(s0, photo, [&filename, began](const photo_t& preview, const size_t samples)
+	{
+		save(preview, filename);
+		printf("preview of %d samples per pixel after %.3f seconds\n", (int)samples, std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count());
+	});
+	printf("traced in %.3f seconds\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count());
+	save(photo, filename);
     
     return 0;
 }
\ No newline at end of file
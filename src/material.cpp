@@ -10,69 +10,131 @@ namespace ray
 		{
 		case TEXTURETYPE_COLOR:
 			this->_colormap = filter;
+			break;
 		case TEXTURETYPE_NORMAL:
 			this->_normalmap = filter;
+			break;
 		case TEXTURETYPE_SPECULAR:
 			this->_specularmap = filter;
+			break;
 		case TEXTURETYPE_TRANSPARENCY:
 			this->_transparencymap = filter;
+			break;
 		case TEXTURETYPE_REFLECTIVITY:
 			this->_reflectivitymap = filter;
+			break;
 		case TEXTURETYPE_EMISSIVE:
 			this->_emissivemap = filter;
+			break;
 		case TEXTURETYPE_DISPLACEMENT:
 			this->_displacementmap = filter;
-		default:
 			break;
+		default:
+			return;
+		}
+		
+		if (filter.image())
+		{
+			this->_bound |= 1 << type;
+		}
+		else
+		{
+			this->_bound &= ~(1 << type);
 		}
 	}
 	
-	glm::vec4 material_t::color(const glm::vec2& texcoord) const
+	void material_t::fallback(const glm::vec4& color, const glm::vec4& specular, const glm::vec4& emissive, const float transparency, const float reflectivity)
 	{
-		return this->_colormap.sample(texcoord);
+		this->_color = color;
+		this->_specular = specular;
+		this->_emissive = emissive;
+		this->_transparency = transparency;
+		this->_reflectivity = reflectivity;
 	}
-	glm::vec3 material_t::normal(const glm::vec2& texcoord) const
+	
+	void material_t::surface(fragment_t& fragment, const float footprint) const
 	{
-		return glm::normalize((glm::vec3(this->_normalmap.sample(texcoord)) * 2.0f) - 1.0f);
+		uint32_t sampled = this->sampled();
+		fragment._transparency = (sampled & TEXTUREFLAG_TRANSPARENCY) != 0 ? this->transparency(fragment._texcoord, footprint) : this->_transparency;
+		fragment._reflectivity = (sampled & TEXTUREFLAG_REFLECTIVITY) != 0 ? this->reflectivity(fragment._texcoord, footprint) : this->_reflectivity;
+		fragment._color = (sampled & TEXTUREFLAG_COLOR) != 0 ? this->color(fragment._texcoord, footprint) : this->_color;
+		fragment._specular = (sampled & TEXTUREFLAG_SPECULAR) != 0 ? this->specular(fragment._texcoord, footprint) : this->_specular;
+		fragment._emissive = (sampled & TEXTUREFLAG_EMISSIVE) != 0 ? this->emissive(fragment._texcoord, footprint) : this->_emissive;
 	}
-	glm::vec4 material_t::specular(const glm::vec2& texcoord) const
+	
+	glm::vec4 material_t::color(const glm::vec2& texcoord, const float footprint) const
 	{
-		return this->_specularmap.sample(texcoord);
+		if ((this->_bound & TEXTUREFLAG_COLOR) == 0)
+		{
+			return this->_color;
+		}
+		
+		return this->_colormap.sample(texcoord, footprint);
 	}
-	glm::vec4 material_t::emissive(const glm::vec2& texcoord) const
+	glm::vec3 material_t::normal(const glm::vec2& texcoord, const float footprint) const
 	{
-		return this->_emissivemap.sample(texcoord);
+		return glm::normalize((glm::vec3(this->_normalmap.sample(texcoord, footprint)) * 2.0f) - 1.0f);
 	}
-	float material_t::transparency(const glm::vec2& texcoord) const
+	glm::vec4 material_t::specular(const glm::vec2& texcoord, const float footprint) const
 	{
-		glm::vec4 color = this->_transparencymap.sample(texcoord);
+		if ((this->_bound & TEXTUREFLAG_SPECULAR) == 0)
+		{
+			return this->_specular;
+		}
+		
+		return this->_specularmap.sample(texcoord, footprint);
+	}
+	glm::vec4 material_t::emissive(const glm::vec2& texcoord, const float footprint) const
+	{
+		if ((this->_bound & TEXTUREFLAG_EMISSIVE) == 0)
+		{
+			return this->_emissive;
+		}
+		
+		return this->_emissivemap.sample(texcoord, footprint);
+	}
+	float material_t::transparency(const glm::vec2& texcoord, const float footprint) const
+	{
+		if ((this->_bound & TEXTUREFLAG_TRANSPARENCY) == 0)
+		{
+			return this->_transparency;
+		}
+		
+		glm::vec4 color = this->_transparencymap.sample(texcoord, footprint);
 		return (color.r + color.g + color.b) / 3.0f;
 	}
-	float material_t::reflectivity(const glm::vec2& texcoord) const
+	float material_t::reflectivity(const glm::vec2& texcoord, const float footprint) const
 	{
-		glm::vec4 color = this->_reflectivitymap.sample(texcoord);
+		if ((this->_bound & TEXTUREFLAG_REFLECTIVITY) == 0)
+		{
+			return this->_reflectivity;
+		}
+		
+		glm::vec4 color = this->_reflectivitymap.sample(texcoord, footprint);
 		return (color.r + color.g + color.b) / 3.0f;
 	}
 	
+	void material_t::shade(const lighting_t* lighting, const fragment_t* fragments, const uint32_t* indices, const size_t count, lumination_t* luminations) const
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			luminations[indices[i]] += this->shade(lighting[i], fragments[indices[i]]);
+		}
+	}
+	
 	lumination_t lambert_t::shade(const lighting_t& lighting, const fragment_t& fragment) const
 	{
-		return lumination_t(
-			glm::max(fragment._color * glm::max(glm::dot(fragment._normal, lighting._direction), 0.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)),
-			glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		return this->evaluate(lighting, fragment);
 	}
 
 	lumination_t phong_t::shade(const lighting_t& lighting, const fragment_t& fragment) const
 	{
-		return lumination_t(
-			glm::max(fragment._color * glm::max(glm::dot(fragment._normal, lighting._direction), 0.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)),
-			glm::max(fragment._specular * glm::max(glm::pow(glm::dot(glm::reflect(-lighting._direction, fragment._normal), fragment._view), this->_exponent), 0.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+		return this->evaluate(lighting, fragment);
 	}
 
 	lumination_t blinn_t::shade(const lighting_t& lighting, const fragment_t& fragment) const
 	{
-		return lumination_t(
-			glm::max(fragment._color * glm::max(glm::dot(fragment._normal, lighting._direction), 0.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)),
-			glm::max(fragment._specular * glm::max(glm::pow(glm::dot(glm::normalize(fragment._normal + fragment._view), fragment._view), this->_exponent), 0.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+		return this->evaluate(lighting, fragment);
 	}
 
 }
\ No newline at end of file
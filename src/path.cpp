@@ -6,38 +6,27 @@ namespace ray
 
 	void tracepath_t::clear()
 	{
-		if (this->_reflection != 0)
-		{
-			delete this->_reflection;
-			this->_reflection = 0;
-		}
-		
-		if (this->_passthrough != 0)
-		{
-			delete this->_passthrough;
-			this->_passthrough = 0;
-		}
+		this->_reflection = 0;
+		this->_passthrough = 0;
+	}
+	
+	void tracepath_t::link(tracepath_t* reflection, tracepath_t* passthrough)
+	{
+		this->_reflection = reflection;
+		this->_passthrough = passthrough;
 	}
 	
 	lumination_t tracepath_t::albedo() const
 	{
-		lumination_t albedo(0.0f, 0.0f);
 		if (this->_stack != 0)
 		{
-			for (std::list<light_t*>::const_iterator i = this->_stack->_lights.begin(); i != this->_stack->_lights.end(); i++)
-			{
-				light_t* light = *i;
-				if (light != 0)
-				{
-					albedo += light->luminance(this->_fragment);
-				}
-			}
+			return this->_stack->illuminate(this->_fragment);
 		}
 		
-		return albedo;
+		return lumination_t(0.0f, 0.0f);
 	}
 
-	const fragment_t tracepath_t::fragment() const
+	const fragment_t& tracepath_t::fragment() const
 	{
 		return this->_fragment;
 	}
@@ -49,4 +38,32 @@ namespace ray
 		return *this;
 	}
 	
+	tracepath_t* patharena_t::allocate(const fragment_t& frag, const tracestack_t& stack)
+	{
+		if (this->_used == this->_chunkSize)
+		{
+			this->_chunk++;
+			this->_used = 0;
+		}
+		
+		if (this->_chunk == this->_chunks.size())
+		{
+			this->_chunks.push_back(std::vector<tracepath_t>(this->_chunkSize));
+			this->_stats._chunks++;
+		}
+		
+		tracepath_t* path = &this->_chunks[this->_chunk][this->_used++];
+		*path = tracepath_t(frag, stack);
+		this->_stats._nodes++;
+		this->_stats._peak = std::max(this->_stats._peak, (this->_chunk * this->_chunkSize) + this->_used);
+		return path;
+	}
+	
+	void patharena_t::reset()
+	{
+		this->_chunk = 0;
+		this->_used = 0;
+		this->_stats._resets++;
+	}
+	
 }
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "../include/RayTracer.h"
+
+namespace ray
+{
+
+	const uint32_t photo_t::missid;
+	
+	/// <summary>
+	/// Weights of the color channels in the luminance that the variance of a pixel is measured in.
+	/// </summary>
+	static const glm::vec3 luminanceweights(0.2126f, 0.7152f, 0.0722f);
+
+	bool photo_t::empty() const
+	{
+		return this->_buffer.empty() || this->_width < 1 || this->_height < 1;
+	}
+
+	void photo_t::resize(const size_t width, const size_t height)
+	{
+		this->_width = std::max(width, (size_t)1ul);
+		this->_height = std::max(height, (size_t)1ul);
+		this->_buffer.assign(this->_width * this->_height, glm::vec4(0.0f));
+		this->_counts.assign(this->_width * this->_height, 0);
+		this->_squares.assign(this->_width * this->_height, 0.0f);
+		this->_ids.assign(this->_width * this->_height, missid);
+		this->_normals.assign(this->_width * this->_height, glm::vec3(0.0f));
+	}
+
+	std::vector<tile_t> photo_t::tiles(const size_t size) const
+	{
+		std::vector<tile_t> tiles;
+		int step = (int)std::max(size, (size_t)1ul);
+		for (int i = 0; i < (int)this->_height; i += step)
+		{
+			for (int k = 0; k < (int)this->_width; k += step)
+			{
+				tiles.push_back(tile_t(
+					glm::ivec2(k, i),
+					glm::ivec2(std::min(k + step, (int)this->_width), std::min(i + step, (int)this->_height))));
+			}
+		}
+
+		return tiles;
+	}
+
+	IMAGETYPE* photo_t::rasterize() const
+	{
+		FIBITMAP* bitmap = FreeImage_Allocate(this->_width, this->_height, 32);
+		if (bitmap != 0 && !this->empty())
+		{
+			for (size_t i = 0; i < this->_height; i++)
+			{
+				for (size_t k = 0; k < this->_width; k++)
+				{
+					glm::vec4 color = glm::clamp(this->color(glm::ivec2(k, i)), glm::vec4(0.0f), glm::vec4(1.0f));
+					RGBQUAD pixel = {
+						(uint8_t)(color.b * 255.0f),
+						(uint8_t)(color.g * 255.0f),
+						(uint8_t)(color.r * 255.0f),
+						(uint8_t)(color.a * 255.0f)
+					};
+					FreeImage_SetPixelColor(bitmap, k, i, &pixel);
+				}
+			}
+		}
+
+		return bitmap;
+	}
+
+	void photo_t::accumulate(const glm::ivec2& coord, const glm::vec4& color)
+	{
+		size_t index = ((coord.y % this->_height) * this->_width) + (coord.x % this->_width);
+		float luminance = glm::dot(glm::vec3(color), luminanceweights);
+		this->_buffer[index] += color;
+		this->_counts[index]++;
+		this->_squares[index] += luminance * luminance;
+	}
+
+	glm::vec4 photo_t::color(const glm::ivec2& coord) const
+	{
+		size_t index = ((coord.y % this->_height) * this->_width) + (coord.x % this->_width);
+		if (this->_counts[index] == 0)
+		{
+			return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+
+		return this->_buffer[index] / float(this->_counts[index]);
+	}
+
+	uint32_t photo_t::samples(const glm::ivec2& coord) const
+	{
+		return this->_counts[((coord.y % this->_height) * this->_width) + (coord.x % this->_width)];
+	}
+
+	void photo_t::surface(const glm::ivec2& coord, const uint32_t id, const glm::vec3& normal)
+	{
+		size_t index = ((coord.y % this->_height) * this->_width) + (coord.x % this->_width);
+		this->_ids[index] = id;
+		this->_normals[index] = normal;
+	}
+
+	std::vector<uint8_t> photo_t::edges(const float facing, const float contrast) const
+	{
+		std::vector<uint8_t> edges(this->_width * this->_height, 0);
+		for (size_t i = 0; i < this->_height; i++)
+		{
+			for (size_t k = 0; k < this->_width; k++)
+			{
+				size_t index = (i * this->_width) + k;
+				glm::vec4 color = this->color(glm::ivec2(k, i));
+				for (int n = 0; n < 2; n++)
+				{
+					size_t x = k + (n == 0 ? 1 : 0);
+					size_t y = i + (n == 0 ? 0 : 1);
+					if (x >= this->_width || y >= this->_height)
+					{
+						continue;
+					}
+
+					size_t other = (y * this->_width) + x;
+					glm::vec4 difference = glm::abs(this->color(glm::ivec2(x, y)) - color);
+					if (this->_ids[index] != this->_ids[other] ||
+						(this->_ids[index] != missid && glm::dot(this->_normals[index], this->_normals[other]) < facing) ||
+						std::max(std::max(difference.r, difference.g), difference.b) > contrast)
+					{
+						edges[index] = 1;
+						edges[other] = 1;
+					}
+				}
+			}
+		}
+
+		return edges;
+	}
+
+	float photo_t::error(const glm::ivec2& coord) const
+	{
+		size_t index = ((coord.y % this->_height) * this->_width) + (coord.x % this->_width);
+		uint32_t count = this->_counts[index];
+		if (count < 2)
+		{
+			return FLT_MAX;
+		}
+		
+		// Unbiased sample variance from the running sums, clamped since rounding can take it slightly under zero.
+		float mean = glm::dot(glm::vec3(this->_buffer[index]), luminanceweights) / float(count);
+		float variance = std::max((this->_squares[index] - (mean * mean * float(count))) / float(count - 1), 0.0f);
+		return 1.96f * std::sqrt(variance / float(count));
+	}
+
+	std::vector<uint8_t> photo_t::noisy(const float threshold, const uint32_t minimum) const
+	{
+		std::vector<uint8_t> noisy(this->_width * this->_height, 0);
+		for (size_t i = 0; i < this->_height; i++)
+		{
+			for (size_t k = 0; k < this->_width; k++)
+			{
+				glm::ivec2 coord(k, i);
+				if (this->samples(coord) < minimum || this->error(coord) > threshold)
+				{
+					noisy[(i * this->_width) + k] = 1;
+				}
+			}
+		}
+
+		return noisy;
+	}
+
+	glm::vec4& photo_t::operator[](const glm::ivec2& coord)
+	{
+		return this->_buffer[((coord.y % this->_height) * this->_width) + (coord.x % this->_width)];
+	}
+	const glm::vec4& photo_t::operator[](const glm::ivec2& coord) const
+	{
+		return this->_buffer[((coord.y % this->_height) * this->_width) + (coord.x % this->_width)];
+	}
+
+}
@@ -4,31 +4,51 @@
 namespace ray
 {
 	
-	lumination_t pointlight_t::luminance(const fragment_t& fragment)
+	lumination_t pointlight_t::luminance(const fragment_t& fragment, const tracestack_t& stack)
 	{
 		if (fragment._material == 0)
 		{
 			return lumination_t(glm::vec4(1.0f, 0.0f, 1.0f, 1.0f), glm::vec4(0.0f));
 		}
 		
+		float occlusion = this->occlusion(fragment, stack);
+		if (occlusion <= 0.0f)
+		{
+			return lumination_t(0.0f, 0.0f);
+		}
+		
 		glm::vec3 l = glm::vec3(this->_position - fragment._position);
 		// float d = glm::length(l);
 		l = normalize(l);
 		// float atten = std::min(this->_intensity / d, 1.0f);
-		return fragment._material->shade(lighting_t(l, /*this->occlusion(fragment) * atten*/1.0f), fragment);
+		return fragment._material->shade(lighting_t(l, occlusion/* * atten*/), fragment);
 	}
 	
-	float pointlight_t::occlusion(const fragment_t& fragment)
+	float pointlight_t::occlusion(const fragment_t& fragment, const tracestack_t& stack)
 	{
-		// if (fragment.material != 0)
-		// {
-		// 	glm::vec3 toLight = this->object->transform->position - fragment.position;
-		// 	ray_t to(fragment.position, glm::normalize(toLight), glm::length(toLight));
-		// 	Fragment occluded = this->object->stack->trace(to, 0);
-		// 	return occluded.material != 0 && occluded.material != fragment.material ? 0.0f : 1.0f;
-		// }
-		
-		return 0.0f;
+		return stack.visibility(fragment, glm::vec3(this->_position));
+	}
+	
+	void pointlightarray_t::clear()
+	{
+		this->_x.clear();
+		this->_y.clear();
+		this->_z.clear();
+		this->_r.clear();
+		this->_g.clear();
+		this->_b.clear();
+		this->_intensity.clear();
+	}
+	
+	void pointlightarray_t::push_back(const pointlight_t* light)
+	{
+		this->_x.push_back(light->position().x);
+		this->_y.push_back(light->position().y);
+		this->_z.push_back(light->position().z);
+		this->_r.push_back(light->color().r);
+		this->_g.push_back(light->color().g);
+		this->_b.push_back(light->color().b);
+		this->_intensity.push_back(light->intensity());
 	}
 	
 }
\ No newline at end of file
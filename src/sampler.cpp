@@ -0,0 +1,77 @@
+#include "../include/RayTracer.h"
+
+namespace ray
+{
+
+	/// <summary>
+	/// Reverses the order of the bits of the given value.
+	/// </summary>
+	static inline uint32_t reverse(uint32_t x)
+	{
+		x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+		x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+		x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+		x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+		return (x >> 16) | (x << 16);
+	}
+
+	/// <summary>
+	/// Owen scrambles the bits of the given value from the highest down, so each bit is flipped by a hash of the bits above it.
+	/// Works on the reversed value with a hash whose every bit only depends on the bits below it.
+	/// </summary>
+	static inline uint32_t scramble(uint32_t x, const uint32_t seed)
+	{
+		x = reverse(x);
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return reverse(x);
+	}
+
+	/// <summary>
+	/// Gets the given point of the first dimension of the Sobol sequence, the van der Corput sequence.
+	/// </summary>
+	static inline uint32_t sobol0(const uint32_t index)
+	{
+		return reverse(index);
+	}
+
+	/// <summary>
+	/// Gets the given point of the second dimension of the Sobol sequence.
+	/// </summary>
+	static inline uint32_t sobol1(uint32_t index)
+	{
+		uint32_t x = 0;
+		for (uint32_t v = 0x80000000u; index != 0; index >>= 1, v ^= v >> 1)
+		{
+			if ((index & 1) != 0)
+			{
+				x ^= v;
+			}
+		}
+
+		return x;
+	}
+
+	/// <summary>
+	/// Converts the highest 24 bits of the given value into a number between zero and one.
+	/// </summary>
+	static inline float unit(const uint32_t x)
+	{
+		return float(x >> 8) / 16777216.0f;
+	}
+
+	glm::vec2 sampler_t::get(const uint32_t dimension) const
+	{
+		uint32_t seed = hash(this->_seed ^ hash(dimension));
+		// Shuffling the index with an owen scramble keeps every aligned run of a power of two samples together,
+		// so the pairs of dimensions stay evenly spread against each other without sharing a single order.
+		uint32_t index = scramble(this->_sample, seed);
+		return glm::vec2(
+			unit(scramble(sobol0(index), hash(seed ^ 0x68bc21ebu))),
+			unit(scramble(sobol1(index), hash(seed ^ 0x02e5be93u))));
+	}
+
+}
\ No newline at end of file
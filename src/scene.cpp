@@ -6,7 +6,7 @@ namespace ray
     
     inline float parse_value(rapidjson::Value& value, float def = 0.0f)
     {
-        return value.IsFloat() ? value.GetFloat() : def;
+        return value.IsNumber() ? (float)value.GetDouble() : def;
     }
     
     inline std::string parse_string(rapidjson::Value& value)
@@ -18,7 +18,7 @@ namespace ray
     {
         rapidjson::Value& x = value["x"];
         rapidjson::Value& y = value["y"];
-        return glm::vec2(x.IsFloat() ? x.GetFloat() : def, y.IsFloat() ? y.GetFloat() : def);
+        return glm::vec2(x.IsNumber() ? (float)x.GetDouble() : def, y.IsNumber() ? (float)y.GetDouble() : def);
     }
     
     inline glm::vec3 parse_vec3(rapidjson::Value& value, float def = 0.0f)
@@ -26,7 +26,7 @@ namespace ray
         rapidjson::Value& x = value["x"];
         rapidjson::Value& y = value["y"];
         rapidjson::Value& z = value["z"];
-        return glm::vec3(x.IsFloat() ? x.GetFloat() : def, y.IsFloat() ? y.GetFloat() : def, z.IsFloat() ? z.GetFloat() : def);
+        return glm::vec3(x.IsNumber() ? (float)x.GetDouble() : def, y.IsNumber() ? (float)y.GetDouble() : def, z.IsNumber() ? (float)z.GetDouble() : def);
     }
     
     inline glm::vec4 parse_vec4(rapidjson::Value& value, float def = 0.0f)
@@ -36,22 +36,31 @@ namespace ray
         rapidjson::Value& z = value["z"];
         rapidjson::Value& w = value["w"];
         return glm::vec4(
-            x.IsFloat() ? x.GetFloat() : def,
-            y.IsFloat() ? y.GetFloat() : def,
-            z.IsFloat() ? z.GetFloat() : def,
-            w.IsFloat() ? w.GetFloat() : def);
+            x.IsNumber() ? (float)x.GetDouble() : def,
+            y.IsNumber() ? (float)y.GetDouble() : def,
+            z.IsNumber() ? (float)z.GetDouble() : def,
+            w.IsNumber() ? (float)w.GetDouble() : def);
     }
     
     inline glm::vec4 parse_color(rapidjson::Value& value)
     {
-        return glm::vec4(1.0f);
+        if (!value.IsObject())
+        {
+            return glm::vec4(1.0f);
+        }
+        
+        return glm::vec4(
+            value.HasMember("r") ? parse_value(value["r"], 1.0f) : 1.0f,
+            value.HasMember("g") ? parse_value(value["g"], 1.0f) : 1.0f,
+            value.HasMember("b") ? parse_value(value["b"], 1.0f) : 1.0f,
+            value.HasMember("a") ? parse_value(value["a"], 1.0f) : 1.0f);
     }
     
     inline transform_t parse_transform(rapidjson::Value& value)
     {
-        glm::vec4 position;
-        glm::vec3 rotation;
-        glm::vec3 scale;
+        glm::vec4 position(0.0f, 0.0f, 0.0f, 1.0f);
+        glm::vec3 rotation(0.0f);
+        glm::vec3 scale(1.0f);
         if (value.HasMember("translate"))
         {
             position = glm::vec4(parse_vec3(value["translate"]), 1.0f);
@@ -68,14 +77,14 @@ namespace ray
         }
         
         if (value.HasMember("tx")) { position.x = parse_value(value["tx"]); }
-        else if (value.HasMember("ty")) { position.y = parse_value(value["ty"]); }
-        else if (value.HasMember("tz")) { position.z = parse_value(value["tz"]); }
-        else if (value.HasMember("rx")) { rotation.x = parse_value(value["rx"]); }
-        else if (value.HasMember("ry")) { rotation.y = parse_value(value["ry"]); }
-        else if (value.HasMember("rz")) { rotation.z = parse_value(value["rz"]); }
-        else if (value.HasMember("sx")) { scale.x = parse_value(value["sx"], 1.0f); }
-        else if (value.HasMember("sy")) { scale.y = parse_value(value["sy"], 1.0f); }
-        else if (value.HasMember("sz")) { scale.z = parse_value(value["sz"], 1.0f); }
+        if (value.HasMember("ty")) { position.y = parse_value(value["ty"]); }
+        if (value.HasMember("tz")) { position.z = parse_value(value["tz"]); }
+        if (value.HasMember("rx")) { rotation.x = parse_value(value["rx"]); }
+        if (value.HasMember("ry")) { rotation.y = parse_value(value["ry"]); }
+        if (value.HasMember("rz")) { rotation.z = parse_value(value["rz"]); }
+        if (value.HasMember("sx")) { scale.x = parse_value(value["sx"], 1.0f); }
+        if (value.HasMember("sy")) { scale.y = parse_value(value["sy"], 1.0f); }
+        if (value.HasMember("sz")) { scale.z = parse_value(value["sz"], 1.0f); }
         
         return transform_t(position, scale, rotation);
     }
@@ -83,20 +92,17 @@ namespace ray
     inline texturefilter_t parse_texture(scene_t& scene, rapidjson::Value& value, TEXTURETYPE* textype)
     {
         std::string type = value.HasMember("type") ? parse_string(value["type"]) : "color";
-        IMAGETYPE* image = 0;
+        std::shared_ptr<const textureimage_t> image;
         if (value.HasMember("filename"))
         {
             std::string filename = parse_string(value["filename"]);
             if (!filename.empty())
             {
                 std::string directory = scene._filename.substr(0, scene._filename.find_last_of('/')) + "/";
-                std::string filetype = filename.substr(filename.find_last_of('.') + 1);
                 printf("    directory: %s\n", directory.c_str());
-                printf("    ext: %s\n", filetype.c_str());
                 filename = directory + filename;
                 printf("    filename: %s\n", filename.c_str());
-                if (filetype == "png") { image = FreeImage_Load(FIF_PNG, filename.c_str(), PNG_DEFAULT); }
-                else if (filetype == "jpg" || filetype == "jpeg") { image = FreeImage_Load(FIF_JPEG, filename.c_str(), JPEG_DEFAULT); }
+                image = scene._textures.acquire(filename);
             }
         }
         
@@ -138,13 +144,24 @@ namespace ray
             material = new blinn_t(value.HasMember("exp") ? parse_value(value["exp"]) : 1.0f);
         }
         
+        if (material != 0)
+        {
+            material->fallback(
+                value.HasMember("color") ? parse_color(value["color"]) : glm::vec4(1.0f),
+                value.HasMember("specular") ? parse_color(value["specular"]) : glm::vec4(1.0f),
+                value.HasMember("emissive") ? parse_color(value["emissive"]) : glm::vec4(0.0f),
+                value.HasMember("transparency") ? parse_value(value["transparency"]) : 0.0f,
+                value.HasMember("reflectivity") ? parse_value(value["reflectivity"]) : 0.0f);
+        }
+        
         if (material != 0 && value.HasMember("textures"))
         {
             rapidjson::Value& textures = value["textures"];
             for (rapidjson::Value::ValueIterator i = textures.Begin(); i != textures.End(); ++i)
             {
-                TEXTURETYPE textype;
-                material->attach(parse_texture(scene, *i, &textype), textype);
+                TEXTURETYPE textype = TEXTURETYPE_COLOR;
+                texturefilter_t filter = parse_texture(scene, *i, &textype);
+                material->attach(filter, textype);
             }
         }
         
@@ -257,6 +274,14 @@ namespace ray
         {
             printf("parsing render\n");
             scene._photo = parse_vec2(render["photo"]);
+            if (render.HasMember("bvh"))
+            {
+                std::string bvh = parse_string(render["bvh"]);
+                printf("  bvh: %s\n", bvh.c_str());
+                if (bvh == "none") { scene._bvh = BVHTYPE_NONE; }
+                else if (bvh == "sah") { scene._bvh = BVHTYPE_SAH; }
+                else if (bvh == "lbvh") { scene._bvh = BVHTYPE_LBVH; }
+            }
         }
         
         rapidjson::Value& camera = document["camera"];
@@ -291,6 +316,29 @@ namespace ray
             }
         }
         
+        if (scene._textures.pending() > 0)
+        {
+            printf("decoding textures\n");
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            threadpool_t pool(std::min(scene._textures.pending(), threadpool_t::concurrency()));
+            size_t decoded = scene._textures.decode(pool);
+            printf("  decoded %d textures (%.1f MB) in %.3f seconds\n", (int)decoded, (double)scene._textures.bytes() / (1024.0 * 1024.0), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        
+        if (scene._bvh != BVHTYPE_NONE)
+        {
+            printf("building bvh (%s)\n", scene._bvh == BVHTYPE_LBVH ? "lbvh" : "sah");
+        }
+        
+        threadpool_t pool;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        scene._stack.build(scene._bvh, pool);
+        if (scene._bvh != BVHTYPE_NONE)
+        {
+            const bvh_t& bvh = scene._stack.bvh();
+            printf("  built %d nodes in %.3f seconds on %d threads, sah cost %.2f\n", (int)bvh._nodes.size(), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), (int)pool.size(), bvh.cost());
+        }
+        
         return 0;
     }
     
@@ -0,0 +1,309 @@
+#include "../include/RayTracer.h"
+
+namespace ray
+{
+
+	void fragmentarray_t::assign(const fragment_t* fragments, const size_t count)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			this->_position[c].resize(count);
+			this->_normal[c].resize(count);
+			this->_view[c].resize(count);
+			this->_color[c].resize(count);
+			this->_specular[c].resize(count);
+			this->_diffuse[c].assign(count, 0.0f);
+			this->_highlight[c].assign(count, 0.0f);
+		}
+
+		this->_occlusion.assign(count, 0.0f);
+		this->_lit.assign(count, 0.0f);
+		for (size_t i = 0; i < count; i++)
+		{
+			const fragment_t& fragment = fragments[i];
+			for (int c = 0; c < 3; c++)
+			{
+				this->_position[c][i] = fragment._position[c];
+				this->_normal[c][i] = fragment._normal[c];
+				this->_view[c][i] = fragment._view[c];
+				this->_color[c][i] = fragment._color[c];
+				this->_specular[c][i] = fragment._specular[c];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Shades the fragments one at a time, the reference every wider kernel matches bit for bit.
+	/// </summary>
+	static void shade_scalar(fragmentarray_t& batch, const glm::vec3& point, const MATERIALTYPE type, const float exponent, const size_t begin, const size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			if (batch._occlusion[i] <= 0.0f)
+			{
+				continue;
+			}
+
+			float nx = batch._normal[0][i];
+			float ny = batch._normal[1][i];
+			float nz = batch._normal[2][i];
+			float vx = batch._view[0][i];
+			float vy = batch._view[1][i];
+			float vz = batch._view[2][i];
+			float lx = point.x - batch._position[0][i];
+			float ly = point.y - batch._position[1][i];
+			float lz = point.z - batch._position[2][i];
+			float inverse = 1.0f / sqrtf((lx * lx) + (ly * ly) + (lz * lz));
+			lx *= inverse;
+			ly *= inverse;
+			lz *= inverse;
+			float ndotl = (nx * lx) + (ny * ly) + (nz * lz);
+			float base;
+			if (type == MATERIALTYPE_PHONG)
+			{
+				float k = 2.0f * ndotl;
+				base = (((k * nx) - lx) * vx) + (((k * ny) - ly) * vy) + (((k * nz) - lz) * vz);
+			}
+			else
+			{
+				float hx = nx + vx;
+				float hy = ny + vy;
+				float hz = nz + vz;
+				base = ((hx * vx) + (hy * vy) + (hz * vz)) * (1.0f / sqrtf((hx * hx) + (hy * hy) + (hz * hz)));
+			}
+
+			float lambert = std::max(ndotl, 0.0f);
+			float highlight = fastpow(std::max(base, 0.0f), exponent);
+			for (int c = 0; c < 3; c++)
+			{
+				batch._diffuse[c][i] += std::max(batch._color[c][i] * lambert, 0.0f);
+				batch._highlight[c][i] += std::max(batch._specular[c][i] * highlight, 0.0f);
+			}
+
+			batch._lit[i] += 1.0f;
+		}
+	}
+
+#if defined(RAYTRACER_SSE)
+	static inline __m128 log2_sse(const __m128 x)
+	{
+		__m128i bits = _mm_castps_si128(x);
+		__m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xff)), _mm_set1_epi32(127)));
+		__m128 mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+		__m128 fold = _mm_cmpgt_ps(mantissa, _mm_set1_ps(1.41421356f));
+		mantissa = _mm_or_ps(_mm_and_ps(fold, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f))), _mm_andnot_ps(fold, mantissa));
+		exponent = _mm_or_ps(_mm_and_ps(fold, _mm_add_ps(exponent, _mm_set1_ps(1.0f))), _mm_andnot_ps(fold, exponent));
+		__m128 s = _mm_div_ps(_mm_sub_ps(mantissa, _mm_set1_ps(1.0f)), _mm_add_ps(mantissa, _mm_set1_ps(1.0f)));
+		__m128 s2 = _mm_mul_ps(s, s);
+		__m128 p = _mm_add_ps(_mm_set1_ps(0.577078016f), _mm_mul_ps(s2, _mm_set1_ps(0.412198583f)));
+		p = _mm_add_ps(_mm_set1_ps(0.961796694f), _mm_mul_ps(s2, p));
+		p = _mm_add_ps(_mm_set1_ps(2.88539008f), _mm_mul_ps(s2, p));
+		return _mm_add_ps(exponent, _mm_mul_ps(s, p));
+	}
+
+	static inline __m128 exp2_sse(const __m128 y)
+	{
+		__m128 clamped = _mm_min_ps(_mm_set1_ps(127.0f), _mm_max_ps(_mm_set1_ps(-126.0f), y));
+		__m128i whole = _mm_cvtps_epi32(clamped);
+		__m128 f = _mm_sub_ps(clamped, _mm_cvtepi32_ps(whole));
+		__m128 p = _mm_add_ps(_mm_set1_ps(0.00133335581f), _mm_mul_ps(f, _mm_set1_ps(0.000154035304f)));
+		p = _mm_add_ps(_mm_set1_ps(0.00961812911f), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(0.0555041087f), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(0.240226507f), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(0.693147182f), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(f, p));
+		return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(whole, _mm_set1_epi32(127)), 23)));
+	}
+
+	static void shade_sse(fragmentarray_t& batch, const glm::vec3& point, const MATERIALTYPE type, const float exponent, const size_t begin, const size_t end)
+	{
+		const __m128 px = _mm_set1_ps(point.x);
+		const __m128 py = _mm_set1_ps(point.y);
+		const __m128 pz = _mm_set1_ps(point.z);
+		const __m128 e = _mm_set1_ps(exponent);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 minimum = _mm_set1_ps(FLT_MIN);
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 lit = _mm_cmpgt_ps(_mm_loadu_ps(&batch._occlusion[i]), zero);
+			if (_mm_movemask_ps(lit) == 0)
+			{
+				continue;
+			}
+
+			__m128 nx = _mm_loadu_ps(&batch._normal[0][i]);
+			__m128 ny = _mm_loadu_ps(&batch._normal[1][i]);
+			__m128 nz = _mm_loadu_ps(&batch._normal[2][i]);
+			__m128 vx = _mm_loadu_ps(&batch._view[0][i]);
+			__m128 vy = _mm_loadu_ps(&batch._view[1][i]);
+			__m128 vz = _mm_loadu_ps(&batch._view[2][i]);
+			__m128 lx = _mm_sub_ps(px, _mm_loadu_ps(&batch._position[0][i]));
+			__m128 ly = _mm_sub_ps(py, _mm_loadu_ps(&batch._position[1][i]));
+			__m128 lz = _mm_sub_ps(pz, _mm_loadu_ps(&batch._position[2][i]));
+			__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz))));
+			lx = _mm_mul_ps(lx, inverse);
+			ly = _mm_mul_ps(ly, inverse);
+			lz = _mm_mul_ps(lz, inverse);
+			__m128 ndotl = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, lx), _mm_mul_ps(ny, ly)), _mm_mul_ps(nz, lz));
+			__m128 base;
+			if (type == MATERIALTYPE_PHONG)
+			{
+				__m128 k = _mm_mul_ps(two, ndotl);
+				base = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(k, nx), lx), vx),
+					_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(k, ny), ly), vy)),
+					_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(k, nz), lz), vz));
+			}
+			else
+			{
+				__m128 hx = _mm_add_ps(nx, vx);
+				__m128 hy = _mm_add_ps(ny, vy);
+				__m128 hz = _mm_add_ps(nz, vz);
+				base = _mm_mul_ps(
+					_mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, vx), _mm_mul_ps(hy, vy)), _mm_mul_ps(hz, vz)),
+					_mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, hx), _mm_mul_ps(hy, hy)), _mm_mul_ps(hz, hz)))));
+			}
+
+			__m128 lambert = _mm_max_ps(ndotl, zero);
+			base = _mm_max_ps(base, zero);
+			__m128 highlight = _mm_and_ps(_mm_cmpgt_ps(base, zero), exp2_sse(_mm_mul_ps(e, log2_sse(_mm_max_ps(base, minimum)))));
+			for (int c = 0; c < 3; c++)
+			{
+				__m128 diffuse = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&batch._color[c][i]), lambert), zero);
+				__m128 specular = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&batch._specular[c][i]), highlight), zero);
+				_mm_storeu_ps(&batch._diffuse[c][i], _mm_add_ps(_mm_loadu_ps(&batch._diffuse[c][i]), _mm_and_ps(lit, diffuse)));
+				_mm_storeu_ps(&batch._highlight[c][i], _mm_add_ps(_mm_loadu_ps(&batch._highlight[c][i]), _mm_and_ps(lit, specular)));
+			}
+
+			_mm_storeu_ps(&batch._lit[i], _mm_add_ps(_mm_loadu_ps(&batch._lit[i]), _mm_and_ps(lit, one)));
+		}
+
+		shade_scalar(batch, point, type, exponent, i, end);
+	}
+#endif
+
+#if defined(RAYTRACER_AVX2)
+	RAYTRACER_AVX2 static inline __m256 log2_avx2(const __m256 x)
+	{
+		__m256i bits = _mm256_castps_si256(x);
+		__m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)), _mm256_set1_epi32(127)));
+		__m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+		__m256 fold = _mm256_cmp_ps(mantissa, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+		mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, _mm256_set1_ps(0.5f)), fold);
+		exponent = _mm256_blendv_ps(exponent, _mm256_add_ps(exponent, _mm256_set1_ps(1.0f)), fold);
+		__m256 s = _mm256_div_ps(_mm256_sub_ps(mantissa, _mm256_set1_ps(1.0f)), _mm256_add_ps(mantissa, _mm256_set1_ps(1.0f)));
+		__m256 s2 = _mm256_mul_ps(s, s);
+		__m256 p = _mm256_add_ps(_mm256_set1_ps(0.577078016f), _mm256_mul_ps(s2, _mm256_set1_ps(0.412198583f)));
+		p = _mm256_add_ps(_mm256_set1_ps(0.961796694f), _mm256_mul_ps(s2, p));
+		p = _mm256_add_ps(_mm256_set1_ps(2.88539008f), _mm256_mul_ps(s2, p));
+		return _mm256_add_ps(exponent, _mm256_mul_ps(s, p));
+	}
+
+	RAYTRACER_AVX2 static inline __m256 exp2_avx2(const __m256 y)
+	{
+		__m256 clamped = _mm256_min_ps(_mm256_set1_ps(127.0f), _mm256_max_ps(_mm256_set1_ps(-126.0f), y));
+		__m256i whole = _mm256_cvtps_epi32(clamped);
+		__m256 f = _mm256_sub_ps(clamped, _mm256_cvtepi32_ps(whole));
+		__m256 p = _mm256_add_ps(_mm256_set1_ps(0.00133335581f), _mm256_mul_ps(f, _mm256_set1_ps(0.000154035304f)));
+		p = _mm256_add_ps(_mm256_set1_ps(0.00961812911f), _mm256_mul_ps(f, p));
+		p = _mm256_add_ps(_mm256_set1_ps(0.0555041087f), _mm256_mul_ps(f, p));
+		p = _mm256_add_ps(_mm256_set1_ps(0.240226507f), _mm256_mul_ps(f, p));
+		p = _mm256_add_ps(_mm256_set1_ps(0.693147182f), _mm256_mul_ps(f, p));
+		p = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(f, p));
+		return _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(whole, _mm256_set1_epi32(127)), 23)));
+	}
+
+	RAYTRACER_AVX2 static void shade_avx2(fragmentarray_t& batch, const glm::vec3& point, const MATERIALTYPE type, const float exponent, const size_t begin, const size_t end)
+	{
+		const __m256 px = _mm256_set1_ps(point.x);
+		const __m256 py = _mm256_set1_ps(point.y);
+		const __m256 pz = _mm256_set1_ps(point.z);
+		const __m256 e = _mm256_set1_ps(exponent);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 two = _mm256_set1_ps(2.0f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 minimum = _mm256_set1_ps(FLT_MIN);
+		size_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 lit = _mm256_cmp_ps(_mm256_loadu_ps(&batch._occlusion[i]), zero, _CMP_GT_OQ);
+			if (_mm256_movemask_ps(lit) == 0)
+			{
+				continue;
+			}
+
+			__m256 nx = _mm256_loadu_ps(&batch._normal[0][i]);
+			__m256 ny = _mm256_loadu_ps(&batch._normal[1][i]);
+			__m256 nz = _mm256_loadu_ps(&batch._normal[2][i]);
+			__m256 vx = _mm256_loadu_ps(&batch._view[0][i]);
+			__m256 vy = _mm256_loadu_ps(&batch._view[1][i]);
+			__m256 vz = _mm256_loadu_ps(&batch._view[2][i]);
+			__m256 lx = _mm256_sub_ps(px, _mm256_loadu_ps(&batch._position[0][i]));
+			__m256 ly = _mm256_sub_ps(py, _mm256_loadu_ps(&batch._position[1][i]));
+			__m256 lz = _mm256_sub_ps(pz, _mm256_loadu_ps(&batch._position[2][i]));
+			__m256 inverse = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, lx), _mm256_mul_ps(ly, ly)), _mm256_mul_ps(lz, lz))));
+			lx = _mm256_mul_ps(lx, inverse);
+			ly = _mm256_mul_ps(ly, inverse);
+			lz = _mm256_mul_ps(lz, inverse);
+			__m256 ndotl = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, lx), _mm256_mul_ps(ny, ly)), _mm256_mul_ps(nz, lz));
+			__m256 base;
+			if (type == MATERIALTYPE_PHONG)
+			{
+				__m256 k = _mm256_mul_ps(two, ndotl);
+				base = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(k, nx), lx), vx),
+					_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(k, ny), ly), vy)),
+					_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(k, nz), lz), vz));
+			}
+			else
+			{
+				__m256 hx = _mm256_add_ps(nx, vx);
+				__m256 hy = _mm256_add_ps(ny, vy);
+				__m256 hz = _mm256_add_ps(nz, vz);
+				base = _mm256_mul_ps(
+					_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(hx, vx), _mm256_mul_ps(hy, vy)), _mm256_mul_ps(hz, vz)),
+					_mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(hx, hx), _mm256_mul_ps(hy, hy)), _mm256_mul_ps(hz, hz)))));
+			}
+
+			__m256 lambert = _mm256_max_ps(ndotl, zero);
+			base = _mm256_max_ps(base, zero);
+			__m256 highlight = _mm256_and_ps(_mm256_cmp_ps(base, zero, _CMP_GT_OQ), exp2_avx2(_mm256_mul_ps(e, log2_avx2(_mm256_max_ps(base, minimum)))));
+			for (int c = 0; c < 3; c++)
+			{
+				__m256 diffuse = _mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(&batch._color[c][i]), lambert), zero);
+				__m256 specular = _mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(&batch._specular[c][i]), highlight), zero);
+				_mm256_storeu_ps(&batch._diffuse[c][i], _mm256_add_ps(_mm256_loadu_ps(&batch._diffuse[c][i]), _mm256_and_ps(lit, diffuse)));
+				_mm256_storeu_ps(&batch._highlight[c][i], _mm256_add_ps(_mm256_loadu_ps(&batch._highlight[c][i]), _mm256_and_ps(lit, specular)));
+			}
+
+			_mm256_storeu_ps(&batch._lit[i], _mm256_add_ps(_mm256_loadu_ps(&batch._lit[i]), _mm256_and_ps(lit, one)));
+		}
+
+		shade_sse(batch, point, type, exponent, i, end);
+	}
+#endif
+
+	void fragmentarray_t::shade(const glm::vec3& point, const MATERIALTYPE type, const float exponent)
+	{
+		switch (simdlevel())
+		{
+#if defined(RAYTRACER_AVX2)
+		case SIMDTYPE_AVX2:
+			shade_avx2(*this, point, type, exponent, 0, this->size());
+			break;
+#endif
+#if defined(RAYTRACER_SSE)
+		case SIMDTYPE_SSE:
+			shade_sse(*this, point, type, exponent, 0, this->size());
+			break;
+#endif
+		default:
+			shade_scalar(*this, point, type, exponent, 0, this->size());
+			break;
+		}
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "../include/RayTracer.h"
+
+#if defined(RAYTRACER_SSE) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ray
+{
+
+	static SIMDTYPE detect()
+	{
+#if defined(RAYTRACER_SSE) && (defined(__GNUC__) || defined(__clang__))
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? SIMDTYPE_AVX2 : SIMDTYPE_SSE;
+#elif defined(RAYTRACER_SSE) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return SIMDTYPE_SSE;
+		}
+
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+		return osxsave && avx2 && (_xgetbv(0) & 0x6) == 0x6 ? SIMDTYPE_AVX2 : SIMDTYPE_SSE;
+#else
+		return SIMDTYPE_SCALAR;
+#endif
+	}
+
+	static SIMDTYPE support = detect();
+	static SIMDTYPE level = support;
+
+	SIMDTYPE simdsupport()
+	{
+		return support;
+	}
+
+	SIMDTYPE simdlevel()
+	{
+		return level;
+	}
+
+	SIMDTYPE simdlimit(const SIMDTYPE type)
+	{
+		level = type < support ? type : support;
+		return level;
+	}
+
+	const char* simdname(const SIMDTYPE type)
+	{
+		switch (type)
+		{
+		case SIMDTYPE_SSE:
+			return "sse";
+		case SIMDTYPE_AVX2:
+			return "avx2";
+		default:
+			return "scalar";
+		}
+	}
+
+}
\ No newline at end of file
@@ -55,7 +55,7 @@ namespace ray
 		vec3 normal = glm::normalize(vec3(hit._intersection) - vec3(this->_center));
 		vec3 tangent = cross(normal, vec3(0.0f, 1.0f, 0.0f));
 		vec2 uv = clamp(vec2((normal.x + 1.0f) / 2.0f, (normal.y + 1.0f) / 2.0f), vec2(0.0f), vec2(1.0f));
-		return fragment_t(
+		fragment_t fragment(
 			this->_material,
 			hit._intersection,
 			uv,
@@ -63,11 +63,227 @@ namespace ray
 			tangent,
 			cross(normal, tangent),
 			-hit._ray._forward,
-			this->_material != 0 ? this->_material->transparency(uv) : 0.0f,
-			this->_material != 0 ? this->_material->reflectivity(uv) : 0.0f,
-			this->_material != 0 ? this->_material->color(uv) : vec4(1.0f, 0.0f, 1.0f, 1.0f),
-			this->_material != 0 ? this->_material->specular(uv) : vec4(0.0f),
-			this->_material != 0 ? this->_material->emissive(uv) : vec4(0.0f));
+			0.0f,
+			0.0f,
+			vec4(1.0f, 0.0f, 1.0f, 1.0f),
+			vec4(0.0f),
+			vec4(0.0f));
+		if (this->_material != 0)
+		{
+			float footprint = 0.0f;
+			if (this->_material->sampled() != 0)
+			{
+				vec3 dpdx;
+				vec3 dpdy;
+				hit._ray._differential.transfer(hit._ray._forward, hit._distance, normal, dpdx, dpdy);
+				footprint = max(length(vec2(dpdx) / (2.0f * this->_radius)), length(vec2(dpdy) / (2.0f * this->_radius)));
+			}
+			
+			this->_material->surface(fragment, footprint);
+		}
+		
+		return fragment;
+	}
+	
+	bounds_t tracesphere_t::bounds() const
+	{
+		return bounds_t(vec3(this->_center) - this->_radius, vec3(this->_center) + this->_radius);
+	}
+	
+	void spherearray_t::clear()
+	{
+		this->_x.clear();
+		this->_y.clear();
+		this->_z.clear();
+		this->_radius.clear();
+		this->_sources.clear();
+	}
+	
+	void spherearray_t::push_back(const tracesphere_t* sphere)
+	{
+		this->_x.push_back(sphere->center().x);
+		this->_y.push_back(sphere->center().y);
+		this->_z.push_back(sphere->center().z);
+		this->_radius.push_back(sphere->radius());
+		this->_sources.push_back(sphere);
+	}
+	
+	static bool nearest_scalar(const spherearray_t& spheres, const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, const bool anyhit)
+	{
+		bool found = false;
+		for (size_t i = begin; i < end; i++)
+		{
+			float t = 0.0f;
+			if (spheres.hitbyray(i, ray, t) && t < distance)
+			{
+				distance = t;
+				index = i;
+				found = true;
+				if (anyhit)
+				{
+					return true;
+				}
+			}
+		}
+		
+		return found;
+	}
+	
+	/// <summary>
+	/// Folds the per lane results of a vector kernel into the nearest hit, preferring the lowest index on ties like the scalar loop does.
+	/// </summary>
+	static bool nearest_lanes(const float* lanes, const int32_t* indices, const size_t count, float& distance, size_t& index)
+	{
+		bool found = false;
+		for (size_t k = 0; k < count; k++)
+		{
+			if (indices[k] >= 0 && (lanes[k] < distance || (found && lanes[k] == distance && size_t(indices[k]) < index)))
+			{
+				distance = lanes[k];
+				index = size_t(indices[k]);
+				found = true;
+			}
+		}
+		
+		return found;
+	}
+	
+#if defined(RAYTRACER_SSE)
+	static bool nearest_sse(const spherearray_t& spheres, const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, const bool anyhit)
+	{
+		const float a = dot(ray._forward, ray._forward);
+		const __m128 ox = _mm_set1_ps(ray._origin.x);
+		const __m128 oy = _mm_set1_ps(ray._origin.y);
+		const __m128 oz = _mm_set1_ps(ray._origin.z);
+		const __m128 fx = _mm_set1_ps(ray._forward.x);
+		const __m128 fy = _mm_set1_ps(ray._forward.y);
+		const __m128 fz = _mm_set1_ps(ray._forward.z);
+		const __m128 a2 = _mm_set1_ps(2.0f * a);
+		const __m128 a4 = _mm_set1_ps(4.0f * a);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		__m128 best = _mm_set1_ps(distance);
+		__m128i bestindex = _mm_set1_epi32(-1);
+		__m128i lane = _mm_setr_epi32(int32_t(begin), int32_t(begin + 1), int32_t(begin + 2), int32_t(begin + 3));
+		const __m128i step = _mm_set1_epi32(4);
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 px = _mm_sub_ps(ox, _mm_loadu_ps(&spheres._x[i]));
+			__m128 py = _mm_sub_ps(oy, _mm_loadu_ps(&spheres._y[i]));
+			__m128 pz = _mm_sub_ps(oz, _mm_loadu_ps(&spheres._z[i]));
+			__m128 r = _mm_loadu_ps(&spheres._radius[i]);
+			__m128 b = _mm_mul_ps(two, _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, fx), _mm_mul_ps(py, fy)), _mm_mul_ps(pz, fz)));
+			__m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)), _mm_mul_ps(pz, pz)), _mm_mul_ps(r, r));
+			__m128 d = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a4, c));
+			__m128 t = _mm_div_ps(_mm_sub_ps(_mm_xor_ps(b, sign), _mm_sqrt_ps(d)), a2);
+			__m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(d, zero), _mm_cmpge_ps(t, zero)), _mm_cmplt_ps(t, best));
+			best = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, best));
+			__m128i imask = _mm_castps_si128(mask);
+			bestindex = _mm_or_si128(_mm_and_si128(imask, lane), _mm_andnot_si128(imask, bestindex));
+			lane = _mm_add_epi32(lane, step);
+			if (anyhit && _mm_movemask_ps(mask) != 0)
+			{
+				break;
+			}
+		}
+		
+		float lanes[4];
+		int32_t indices[4];
+		_mm_storeu_ps(lanes, best);
+		_mm_storeu_si128((__m128i*)indices, bestindex);
+		bool found = nearest_lanes(lanes, indices, 4, distance, index);
+		if (found && anyhit)
+		{
+			return true;
+		}
+		
+		return nearest_scalar(spheres, ray, i, end, distance, index, anyhit) || found;
+	}
+#endif
+	
+#if defined(RAYTRACER_AVX2)
+	RAYTRACER_AVX2 static bool nearest_avx2(const spherearray_t& spheres, const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, const bool anyhit)
+	{
+		const float a = dot(ray._forward, ray._forward);
+		const __m256 ox = _mm256_set1_ps(ray._origin.x);
+		const __m256 oy = _mm256_set1_ps(ray._origin.y);
+		const __m256 oz = _mm256_set1_ps(ray._origin.z);
+		const __m256 fx = _mm256_set1_ps(ray._forward.x);
+		const __m256 fy = _mm256_set1_ps(ray._forward.y);
+		const __m256 fz = _mm256_set1_ps(ray._forward.z);
+		const __m256 a2 = _mm256_set1_ps(2.0f * a);
+		const __m256 a4 = _mm256_set1_ps(4.0f * a);
+		const __m256 two = _mm256_set1_ps(2.0f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		__m256 best = _mm256_set1_ps(distance);
+		__m256i bestindex = _mm256_set1_epi32(-1);
+		__m256i lane = _mm256_add_epi32(_mm256_set1_epi32(int32_t(begin)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		const __m256i step = _mm256_set1_epi32(8);
+		size_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 px = _mm256_sub_ps(ox, _mm256_loadu_ps(&spheres._x[i]));
+			__m256 py = _mm256_sub_ps(oy, _mm256_loadu_ps(&spheres._y[i]));
+			__m256 pz = _mm256_sub_ps(oz, _mm256_loadu_ps(&spheres._z[i]));
+			__m256 r = _mm256_loadu_ps(&spheres._radius[i]);
+			__m256 b = _mm256_mul_ps(two, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, fx), _mm256_mul_ps(py, fy)), _mm256_mul_ps(pz, fz)));
+			__m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(py, py)), _mm256_mul_ps(pz, pz)), _mm256_mul_ps(r, r));
+			__m256 d = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a4, c));
+			__m256 t = _mm256_div_ps(_mm256_sub_ps(_mm256_xor_ps(b, sign), _mm256_sqrt_ps(d)), a2);
+			__m256 mask = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(d, zero, _CMP_GE_OQ), _mm256_cmp_ps(t, zero, _CMP_GE_OQ)), _mm256_cmp_ps(t, best, _CMP_LT_OQ));
+			best = _mm256_blendv_ps(best, t, mask);
+			bestindex = _mm256_blendv_epi8(bestindex, lane, _mm256_castps_si256(mask));
+			lane = _mm256_add_epi32(lane, step);
+			if (anyhit && _mm256_movemask_ps(mask) != 0)
+			{
+				break;
+			}
+		}
+		
+		float lanes[8];
+		int32_t indices[8];
+		_mm256_storeu_ps(lanes, best);
+		_mm256_storeu_si256((__m256i*)indices, bestindex);
+		bool found = nearest_lanes(lanes, indices, 8, distance, index);
+		if (found && anyhit)
+		{
+			return true;
+		}
+		
+		return nearest_sse(spheres, ray, i, end, distance, index, anyhit) || found;
+	}
+#endif
+	
+	static bool intersect(const spherearray_t& spheres, const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index, const bool anyhit)
+	{
+		switch (simdlevel())
+		{
+#if defined(RAYTRACER_AVX2)
+		case SIMDTYPE_AVX2:
+			return nearest_avx2(spheres, ray, begin, end, distance, index, anyhit);
+#endif
+#if defined(RAYTRACER_SSE)
+		case SIMDTYPE_SSE:
+			return nearest_sse(spheres, ray, begin, end, distance, index, anyhit);
+#endif
+		default:
+			return nearest_scalar(spheres, ray, begin, end, distance, index, anyhit);
+		}
+	}
+	
+	bool spherearray_t::nearest(const ray_t& ray, const size_t begin, const size_t end, float& distance, size_t& index) const
+	{
+		return intersect(*this, ray, begin, end, distance, index, false);
+	}
+	
+	bool spherearray_t::occluded(const ray_t& ray, const size_t begin, const size_t end, const float distance) const
+	{
+		float t = distance;
+		size_t index = 0;
+		return intersect(*this, ray, begin, end, t, index, true);
 	}
 	
 }
\ No newline at end of file
@@ -1,11 +1,240 @@
-
 #include "../include/RayTracer.h"
 
 namespace ray
 {
 
+	/// <summary>
+	/// Tests the primitives of hierarchy leaves for the nearest hit.
+	/// </summary>
+	struct nearesthit_t
+	{
+		inline nearesthit_t(const tracestack_t& stack, const ray_t& ray) :
+			_stack(&stack),
+			_ray(&ray),
+			_id(0),
+			_face(-1),
+			_found(false) {}
+
+		inline bool operator()(const uint32_t* ids, const size_t count, float& distance)
+		{
+			size_t i = 0;
+			while (i < count)
+			{
+				// Primitives of a leaf sit next to each other in their arrays, so each run of a single type is tested as one batch.
+				SHAPETYPE type = primitivetype(ids[i]);
+				size_t first = primitiveindex(ids[i]);
+				size_t last = first + 1;
+				for (i++; i < count && ids[i] == primitiveid(type, last); i++)
+				{
+					last++;
+				}
+
+				this->batch(type, first, last, distance);
+			}
+
+			return false;
+		}
+
+		inline void batch(const SHAPETYPE type, const size_t first, const size_t last, float& distance)
+		{
+			size_t index = 0;
+			int face = -1;
+			switch (type)
+			{
+			case SHAPETYPE_SPHERE:
+				if (this->_stack->spheres().nearest(*this->_ray, first, last, distance, index))
+				{
+					this->_id = primitiveid(type, index);
+					this->_face = -1;
+					this->_found = true;
+				}
+				break;
+			case SHAPETYPE_AXISCUBE:
+				if (this->_stack->cubes().nearest(*this->_ray, first, last, distance, index, face))
+				{
+					this->_id = primitiveid(type, index);
+					this->_face = face;
+					this->_found = true;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		const tracestack_t* _stack;
+		const ray_t* _ray;
+		uint32_t _id;
+		int _face;
+		bool _found;
+	};
+
+	/// <summary>
+	/// Tests the primitives of hierarchy leaves for the farthest hit.
+	/// </summary>
+	struct farthesthit_t
+	{
+		inline farthesthit_t(const tracestack_t& stack, const ray_t& ray) :
+			_stack(&stack),
+			_ray(&ray),
+			_id(0),
+			_face(-1),
+			_found(false),
+			_distance(0.0f) {}
+
+		inline bool operator()(const uint32_t* ids, const size_t count, float& distance)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				float t = 0.0f;
+				int face = -1;
+				if (this->_stack->hitbyray(ids[i], *this->_ray, t, face) && t >= this->_distance)
+				{
+					this->_distance = t;
+					this->_id = ids[i];
+					this->_face = face;
+					this->_found = true;
+				}
+			}
+
+			return false;
+		}
+
+		const tracestack_t* _stack;
+		const ray_t* _ray;
+		uint32_t _id;
+		int _face;
+		bool _found;
+		float _distance;
+	};
+
+	/// <summary>
+	/// Tests the primitives of hierarchy leaves for any hit, stopping the walk at the first one.
+	/// </summary>
+	struct anyhit_t
+	{
+		inline anyhit_t(const tracestack_t& stack, const ray_t& ray) :
+			_stack(&stack),
+			_ray(&ray) {}
+
+		inline bool operator()(const uint32_t* ids, const size_t count, float& distance)
+		{
+			size_t i = 0;
+			while (i < count)
+			{
+				SHAPETYPE type = primitivetype(ids[i]);
+				size_t first = primitiveindex(ids[i]);
+				size_t last = first + 1;
+				for (i++; i < count && ids[i] == primitiveid(type, last); i++)
+				{
+					last++;
+				}
+
+				if (this->batch(type, first, last, distance))
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		inline bool batch(const SHAPETYPE type, const size_t first, const size_t last, const float distance) const
+		{
+			switch (type)
+			{
+			case SHAPETYPE_SPHERE:
+				return this->_stack->spheres().occluded(*this->_ray, first, last, distance);
+			case SHAPETYPE_AXISCUBE:
+				return this->_stack->cubes().occluded(*this->_ray, first, last, distance);
+			default:
+				return false;
+			}
+		}
+
+		const tracestack_t* _stack;
+		const ray_t* _ray;
+	};
+
+	/// <summary>
+	/// Tests the primitives of hierarchy leaves for the nearest hit of each ray of a packet.
+	/// </summary>
+	struct packetnearesthit_t
+	{
+		inline packetnearesthit_t(const tracestack_t& stack, const raypacket_t& packet, hitrecord_t* records) :
+			_stack(&stack),
+			_packet(&packet),
+			_records(records) {}
+
+		inline bool operator()(const size_t lane, const uint32_t* ids, const size_t count, float& distance)
+		{
+			ray_t ray = this->_packet->ray(lane);
+			nearesthit_t intersect(*this->_stack, ray);
+			intersect(ids, count, distance);
+			if (intersect._found)
+			{
+				this->_records[lane] = hitrecord_t(intersect._id, distance, intersect._face);
+			}
+
+			return false;
+		}
+
+		const tracestack_t* _stack;
+		const raypacket_t* _packet;
+		hitrecord_t* _records;
+	};
+
+	/// <summary>
+	/// Tests the primitives of hierarchy leaves for any hit of each ray of a packet, retiring each ray at its first hit.
+	/// </summary>
+	struct packetanyhit_t
+	{
+		inline packetanyhit_t(const tracestack_t& stack, const raypacket_t& packet, float* occlusion) :
+			_stack(&stack),
+			_packet(&packet),
+			_occlusion(occlusion) {}
+
+		inline bool operator()(const size_t lane, const uint32_t* ids, const size_t count, float& distance)
+		{
+			ray_t ray = this->_packet->ray(lane);
+			anyhit_t intersect(*this->_stack, ray);
+			if (intersect(ids, count, distance))
+			{
+				this->_occlusion[lane] = 0.0f;
+				return true;
+			}
+
+			return false;
+		}
+
+		const tracestack_t* _stack;
+		const raypacket_t* _packet;
+		float* _occlusion;
+	};
+
+	/// <summary>
+	/// Distance shadow rays start above the surface, so they do not hit the surface they leave from.
+	/// </summary>
+	static const float shadowbias = 0.001f;
+
 	const traceable_t* tracestack_t::nearest(const ray_t& ray, rayhit_t* hit) const
 	{
+		if (this->_compiled)
+		{
+			hitrecord_t record;
+			if (!this->intersect(ray, record))
+			{
+				return 0;
+			}
+
+			if (hit != 0)
+			{
+				*hit = rayhit_t(ray, record._distance, ray._origin + glm::vec4(ray._forward * record._distance, 0.0f), record._face);
+			}
+
+			return this->source(record._id);
+		}
+
 		float check = FLT_MAX;
 		const traceable_t* nearest = 0;
 		for (std::list<traceable_t*>::const_iterator i = this->_traceables.begin(); i != this->_traceables.end(); i++)
@@ -28,8 +257,100 @@ namespace ray
 
 		return nearest;
 	}
+	bool tracestack_t::intersect(const ray_t& ray, hitrecord_t& record) const
+	{
+		float distance = FLT_MAX;
+		nearesthit_t intersect(*this, ray);
+		if (!this->_bvh.empty())
+		{
+			this->_bvh.traverse(ray, distance, intersect);
+		}
+		else
+		{
+			intersect.batch(SHAPETYPE_SPHERE, 0, this->_spheres.size(), distance);
+			intersect.batch(SHAPETYPE_AXISCUBE, 0, this->_cubes.size(), distance);
+		}
+
+		if (!intersect._found)
+		{
+			return false;
+		}
+
+		record = hitrecord_t(intersect._id, distance, intersect._face);
+		return true;
+	}
+	
+	void tracestack_t::intersect(const ray_t* rays, const size_t count, hitrecord_t* records) const
+	{
+		std::fill(records, records + count, hitrecord_t());
+		if (this->_bvh.empty())
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				this->intersect(rays[i], records[i]);
+			}
+
+			return;
+		}
+
+		float distances[raypacket_t::maxsize];
+		for (size_t begin = 0; begin < count; begin += raypacket_t::maxsize)
+		{
+			raypacket_t packet;
+			for (size_t i = begin; i < std::min(begin + raypacket_t::maxsize, count); i++)
+			{
+				packet.push_back(glm::vec3(rays[i]._origin), rays[i]._forward);
+				distances[i - begin] = FLT_MAX;
+			}
+
+			packetnearesthit_t intersect(*this, packet, records + begin);
+			this->_bvh.traverse(packet, distances, intersect);
+		}
+	}
+	
+	fragment_t tracestack_t::fragmentate(const ray_t& ray, const hitrecord_t& record) const
+	{
+		return this->source(record._id)->fragmentate(rayhit_t(ray, record._distance, ray._origin + glm::vec4(ray._forward * record._distance, 0.0f), record._face));
+	}
+	
 	const traceable_t* tracestack_t::farthest(const ray_t& ray, rayhit_t* hit) const
 	{
+		if (this->_compiled)
+		{
+			float distance = FLT_MAX;
+			farthesthit_t intersect(*this, ray);
+			if (!this->_bvh.empty())
+			{
+				this->_bvh.traverse(ray, distance, intersect);
+			}
+			else
+			{
+				for (size_t i = 0; i < this->_spheres.size(); i++)
+				{
+					uint32_t id = primitiveid(SHAPETYPE_SPHERE, i);
+					intersect(&id, 1, distance);
+				}
+
+				for (size_t i = 0; i < this->_cubes.size(); i++)
+				{
+					uint32_t id = primitiveid(SHAPETYPE_AXISCUBE, i);
+					intersect(&id, 1, distance);
+				}
+			}
+
+			if (!intersect._found)
+			{
+				return 0;
+			}
+
+			if (hit != 0)
+			{
+				*hit = rayhit_t(ray, intersect._distance, ray._origin + glm::vec4(ray._forward * intersect._distance, 0.0f), intersect._face);
+			}
+
+			return this->source(intersect._id);
+		}
+
 		float check = 0.0f;
 		const traceable_t* farthest = 0;
 		for (std::list<traceable_t*>::const_reverse_iterator i = this->_traceables.rbegin(); i != this->_traceables.rend(); i++)
@@ -53,4 +374,383 @@ namespace ray
 		return farthest;
 	}
 
+	bool tracestack_t::occluded(const ray_t& ray, const float tmax) const
+	{
+		if (this->_compiled)
+		{
+			float distance = tmax;
+			anyhit_t intersect(*this, ray);
+			if (!this->_bvh.empty())
+			{
+				return this->_bvh.traverse(ray, distance, intersect);
+			}
+
+			return intersect.batch(SHAPETYPE_SPHERE, 0, this->_spheres.size(), distance) || intersect.batch(SHAPETYPE_AXISCUBE, 0, this->_cubes.size(), distance);
+		}
+
+		for (std::list<traceable_t*>::const_iterator i = this->_traceables.begin(); i != this->_traceables.end(); i++)
+		{
+			rayhit_t hit;
+			const traceable_t* obj = *i;
+			if (obj != 0 && obj->hitbyray(ray, &hit) && hit._distance < tmax)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	float tracestack_t::visibility(const fragment_t& fragment, const glm::vec3& point) const
+	{
+		glm::vec3 origin = glm::vec3(fragment._position) + (fragment._normal * shadowbias);
+		glm::vec3 tolight = point - origin;
+		float distance = glm::length(tolight);
+		if (distance <= 0.0f)
+		{
+			return 1.0f;
+		}
+
+		return this->occluded(ray_t(origin, tolight / distance), distance) ? 0.0f : 1.0f;
+	}
+
+	void tracestack_t::visibility(const fragment_t* fragments, const size_t count, const glm::vec3& point, float* occlusion, const size_t packet) const
+	{
+		if (packet <= 1 || this->_bvh.empty())
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				occlusion[i] = this->visibility(fragments[i], point);
+			}
+
+			return;
+		}
+
+		size_t size = std::min(packet, raypacket_t::maxsize);
+		float distances[raypacket_t::maxsize];
+		float reached[raypacket_t::maxsize];
+		size_t indices[raypacket_t::maxsize];
+		for (size_t begin = 0; begin < count; begin += size)
+		{
+			// Fragments sitting on the light have no direction to it and are always lit, so they are left out of the packet.
+			raypacket_t shadows;
+			for (size_t i = begin; i < std::min(begin + size, count); i++)
+			{
+				glm::vec3 origin = glm::vec3(fragments[i]._position) + (fragments[i]._normal * shadowbias);
+				glm::vec3 tolight = point - origin;
+				float distance = glm::length(tolight);
+				occlusion[i] = 1.0f;
+				if (distance > 0.0f)
+				{
+					distances[shadows._count] = distance;
+					reached[shadows._count] = 1.0f;
+					indices[shadows._count] = i;
+					shadows.push_back(origin, tolight / distance);
+				}
+			}
+
+			packetanyhit_t intersect(*this, shadows, reached);
+			this->_bvh.traverse(shadows, distances, intersect);
+			for (size_t i = 0; i < shadows._count; i++)
+			{
+				occlusion[indices[i]] = reached[i];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Shades a batch of fragments that share a material with every light of an array, adding to each fragment's lumination.
+	/// Specialized on both the material and the light type, so the shading model is inlined into the loop.
+	/// </summary>
+	template <typename M, typename L>
+	static void shade(const tracestack_t& stack, const M& material, const L& lights, const fragment_t* fragments, const size_t count, lumination_t* luminations, float* occlusion, const size_t packet)
+	{
+		for (size_t l = 0; l < lights.size(); l++)
+		{
+			glm::vec3 point = lights.position(l);
+			stack.visibility(fragments, count, point, occlusion, packet);
+			for (size_t i = 0; i < count; i++)
+			{
+				if (occlusion[i] > 0.0f)
+				{
+					luminations[i] += material.evaluate(lights.lighting(l, fragments[i], occlusion[i]), fragments[i]);
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Shades a batch of phong or blinn fragments with every light of an array through a flat fragment array,
+	/// so the highlight is calculated for several fragments per instruction.
+	/// </summary>
+	template <typename L>
+	static void shade(const tracestack_t& stack, const MATERIALTYPE type, const float exponent, const L& lights, const fragment_t* fragments, const size_t count, lumination_t* luminations, fragmentarray_t& batch, const size_t packet)
+	{
+		batch.assign(fragments, count);
+		for (size_t l = 0; l < lights.size(); l++)
+		{
+			glm::vec3 point = lights.position(l);
+			stack.visibility(fragments, count, point, &batch._occlusion[0], packet);
+			batch.shade(point, type, exponent);
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			luminations[i] += batch.lumination(i);
+		}
+	}
+
+	/// <summary>
+	/// Picks the specialized kernel for the given material once for the whole batch.
+	/// Phong and blinn batches go through the flat fragment array when one is given, without one the batch must be a single fragment.
+	/// </summary>
+	/// <returns>False if the material is not one of the built in shading models.</returns>
+	template <typename L>
+	static bool shade(const tracestack_t& stack, const material_t* material, const L& lights, const fragment_t* fragments, const size_t count, lumination_t* luminations, fragmentarray_t* batch, const size_t packet)
+	{
+		float single = 0.0f;
+		float* occlusion = &single;
+		if (batch != 0)
+		{
+			batch->_occlusion.resize(count);
+			occlusion = &batch->_occlusion[0];
+		}
+
+		switch (material->type())
+		{
+		case MATERIALTYPE_LAMBERT:
+			shade(stack, *static_cast<const lambert_t*>(material), lights, fragments, count, luminations, occlusion, packet);
+			return true;
+		case MATERIALTYPE_PHONG:
+			if (batch != 0)
+			{
+				shade(stack, MATERIALTYPE_PHONG, static_cast<const phong_t*>(material)->exponent(), lights, fragments, count, luminations, *batch, packet);
+				return true;
+			}
+
+			shade(stack, *static_cast<const phong_t*>(material), lights, fragments, count, luminations, occlusion, packet);
+			return true;
+		case MATERIALTYPE_BLINN:
+			if (batch != 0)
+			{
+				shade(stack, MATERIALTYPE_BLINN, static_cast<const blinn_t*>(material)->exponent(), lights, fragments, count, luminations, *batch, packet);
+				return true;
+			}
+
+			shade(stack, *static_cast<const blinn_t*>(material), lights, fragments, count, luminations, occlusion, packet);
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	lumination_t tracestack_t::illuminate(const fragment_t& fragment) const
+	{
+		lumination_t albedo(0.0f, 0.0f);
+		if (this->_compiled)
+		{
+			if (fragment._material != 0 && shade(*this, fragment._material, this->_pointlights, &fragment, 1, &albedo, static_cast<fragmentarray_t*>(0), 1))
+			{
+				return albedo;
+			}
+
+			glm::vec3 position(fragment._position);
+			for (size_t i = 0; i < this->_pointlights.size(); i++)
+			{
+				if (fragment._material == 0)
+				{
+					albedo += lumination_t(glm::vec4(1.0f, 0.0f, 1.0f, 1.0f), glm::vec4(0.0f));
+					continue;
+				}
+
+				glm::vec3 point(this->_pointlights._x[i], this->_pointlights._y[i], this->_pointlights._z[i]);
+				float occlusion = this->visibility(fragment, point);
+				if (occlusion <= 0.0f)
+				{
+					continue;
+				}
+
+				albedo += fragment._material->shade(lighting_t(glm::normalize(point - position), occlusion), fragment);
+			}
+
+			return albedo;
+		}
+
+		for (std::list<light_t*>::const_iterator i = this->_lights.begin(); i != this->_lights.end(); i++)
+		{
+			light_t* light = *i;
+			if (light != 0)
+			{
+				albedo += light->luminance(fragment, *this);
+			}
+		}
+
+		return albedo;
+	}
+
+	void tracestack_t::illuminate(const material_t* material, const fragment_t* fragments, const size_t count, lumination_t* luminations, std::vector<lighting_t>& lighting, std::vector<uint32_t>& indices, fragmentarray_t& batch, const size_t packet) const
+	{
+		if (!this->_compiled)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				luminations[i] += this->illuminate(fragments[i]);
+			}
+
+			return;
+		}
+
+		if (material != 0 && shade(*this, material, this->_pointlights, fragments, count, luminations, &batch, packet))
+		{
+			return;
+		}
+
+		for (size_t l = 0; l < this->_pointlights.size(); l++)
+		{
+			if (material == 0)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					luminations[i] += lumination_t(glm::vec4(1.0f, 0.0f, 1.0f, 1.0f), glm::vec4(0.0f));
+				}
+
+				continue;
+			}
+
+			glm::vec3 point = this->_pointlights.position(l);
+			lighting.clear();
+			indices.clear();
+			for (size_t i = 0; i < count; i++)
+			{
+				float occlusion = this->visibility(fragments[i], point);
+				if (occlusion > 0.0f)
+				{
+					lighting.push_back(this->_pointlights.lighting(l, fragments[i], occlusion));
+					indices.push_back(uint32_t(i));
+				}
+			}
+
+			if (!indices.empty())
+			{
+				material->shade(&lighting[0], fragments, &indices[0], indices.size(), luminations);
+			}
+		}
+	}
+
+	void tracestack_t::build(const BVHTYPE type)
+	{
+		this->build(type, 0);
+	}
+	void tracestack_t::build(const BVHTYPE type, threadpool_t& pool)
+	{
+		this->build(type, &pool);
+	}
+
+	void tracestack_t::build(const BVHTYPE type, threadpool_t* pool)
+	{
+		this->_spheres.clear();
+		this->_cubes.clear();
+		this->_pointlights.clear();
+		this->_bvh.clear();
+		for (std::list<traceable_t*>::const_iterator i = this->_traceables.begin(); i != this->_traceables.end(); i++)
+		{
+			const traceable_t* obj = *i;
+			if (obj != 0)
+			{
+				switch (obj->type())
+				{
+				case SHAPETYPE_SPHERE:
+					this->_spheres.push_back(static_cast<const tracesphere_t*>(obj));
+					break;
+				case SHAPETYPE_AXISCUBE:
+					this->_cubes.push_back(static_cast<const traceaxiscube_t*>(obj));
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+		for (std::list<light_t*>::const_iterator i = this->_lights.begin(); i != this->_lights.end(); i++)
+		{
+			const light_t* light = *i;
+			if (light != 0 && light->type() == LIGHTTYPE_POINT)
+			{
+				this->_pointlights.push_back(static_cast<const pointlight_t*>(light));
+			}
+		}
+
+		this->_compiled = true;
+		if (type == BVHTYPE_NONE || (this->_spheres.size() + this->_cubes.size()) == 0)
+		{
+			return;
+		}
+
+		std::vector<bounds_t> bounds;
+		std::vector<uint32_t> ids;
+		for (size_t i = 0; i < this->_spheres.size(); i++)
+		{
+			bounds.push_back(this->_spheres._sources[i]->bounds());
+			ids.push_back(primitiveid(SHAPETYPE_SPHERE, i));
+		}
+
+		for (size_t i = 0; i < this->_cubes.size(); i++)
+		{
+			bounds.push_back(this->_cubes._sources[i]->bounds());
+			ids.push_back(primitiveid(SHAPETYPE_AXISCUBE, i));
+		}
+
+		if (pool != 0)
+		{
+			this->_bvh.build(bounds, *pool, type);
+		}
+		else
+		{
+			this->_bvh.build(bounds, type);
+		}
+
+		// Reorder the flat arrays into the order the leaves visit them, so neighbouring leaves share cache lines.
+		spherearray_t spheres;
+		cubearray_t cubes;
+		for (std::vector<uint32_t>::iterator i = this->_bvh._indices.begin(); i != this->_bvh._indices.end(); i++)
+		{
+			uint32_t id = ids[*i];
+			switch (primitivetype(id))
+			{
+			case SHAPETYPE_SPHERE:
+				spheres.push_back(this->_spheres._sources[primitiveindex(id)]);
+				*i = primitiveid(SHAPETYPE_SPHERE, spheres.size() - 1);
+				break;
+			case SHAPETYPE_AXISCUBE:
+				cubes.push_back(this->_cubes._sources[primitiveindex(id)]);
+				*i = primitiveid(SHAPETYPE_AXISCUBE, cubes.size() - 1);
+				break;
+			default:
+				break;
+			}
+		}
+
+		this->_spheres = spheres;
+		this->_cubes = cubes;
+	}
+
+	const traceable_t* tracestack_t::source(const uint32_t id) const
+	{
+		switch (primitivetype(id))
+		{
+		case SHAPETYPE_SPHERE:
+			return this->_spheres._sources[primitiveindex(id)];
+		case SHAPETYPE_AXISCUBE:
+			return this->_cubes._sources[primitiveindex(id)];
+		default:
+			return 0;
+		}
+	}
+	
+	const material_t* tracestack_t::material(const uint32_t id) const
+	{
+		const traceable_t* source = this->source(id);
+		return source != 0 ? source->_material : 0;
+	}
+
 }
\ No newline at end of file
@@ -1,62 +1,185 @@
-
 #include "../include/RayTracer.h"
 
 namespace ray
 {
 	
-	glm::vec4 texturefilter_t::sample(const glm::vec2& texcoord) const
+	/// <summary>
+	/// Lookup table from a byte channel to the same channel as a zero to one float.
+	/// </summary>
+	struct bytetable_t
 	{
-		if (this->_texture != 0)
+		inline bytetable_t()
 		{
-			size_t width = FreeImage_GetWidth(this->_texture);
-			size_t height = FreeImage_GetHeight(this->_texture);
-			if (this->_type == SAMPLETYPE_NEAREST)
+			for (size_t i = 0; i < 256; i++)
 			{
-				RGBQUAD pixel;
-				if (FreeImage_GetPixelColor(this->_texture, (int)texcoord.x, (int)texcoord.y, &pixel))
-				{
-					return unpack(pixel.rgbRed, pixel.rgbGreen, pixel.rgbBlue, pixel.rgbReserved);
-				}
+				this->_values[i] = ((float)i) / 255.0f;
 			}
-			else if (this->_type == SAMPLETYPE_LINEAR)
+		}
+		
+		float _values[256];
+	};
+	
+	static const bytetable_t bytetable;
+	
+	textureimage_t::textureimage_t(IMAGETYPE* source) :
+		_width(0),
+		_height(0)
+	{
+		this->decode(source);
+	}
+	
+	void textureimage_t::decode(IMAGETYPE* source)
+	{
+		this->_pixels.clear();
+		this->_levels.clear();
+		this->_width = 0;
+		this->_height = 0;
+		if (source == 0)
+		{
+			return;
+		}
+		
+		IMAGETYPE* image = FreeImage_ConvertTo32Bits(source);
+		if (image == 0)
+		{
+			return;
+		}
+		
+		this->_width = FreeImage_GetWidth(image);
+		this->_height = FreeImage_GetHeight(image);
+		this->_pixels.resize(this->_width * this->_height);
+		for (size_t y = 0; y < this->_height; y++)
+		{
+			const BYTE* line = FreeImage_GetScanLine(image, (int)y);
+			for (size_t x = 0; x < this->_width; x++)
 			{
-				glm::vec2 increment = 1.0f / glm::vec2(float(width), float(height));
-				glm::vec2 uv0 = glm::vec2(fmod(texcoord.x, increment.x), fmod(texcoord.y, increment.y)) / increment;
-				glm::vec2 uv1 = 1.0f - uv0;
-				glm::vec2 linear0 = glm::normalize(uv0) * 0.25f;
-				glm::vec2 linear1 = glm::normalize(glm::vec2(uv1.x, uv0.y)) * 0.25f;
-				glm::vec2 linear2 = glm::normalize(glm::vec2(uv0.x, uv1.y)) * 0.25f;
-				glm::vec2 linear3 = glm::normalize(uv1) * 0.25f;
-				size_t x0 = (size_t)(texcoord.x * float(width));
-				size_t y0 = (size_t)(texcoord.y * float(height));
-				size_t x1 = std::min(x0 + 1, width);
-				size_t y1 = std::min(y0 + 1, height);
-				RGBQUAD pixel0, pixel1, pixel2, pixel3;
-				if (FreeImage_GetPixelColor(this->_texture, x0, y0, &pixel0) &&
-					FreeImage_GetPixelColor(this->_texture, x1, y0, &pixel1) &&
-					FreeImage_GetPixelColor(this->_texture, x0, y1, &pixel2) &&
-					FreeImage_GetPixelColor(this->_texture, x1, y1, &pixel3))
+				const BYTE* pixel = line + (x * 4);
+				this->_pixels[(y * this->_width) + x] =
+					((uint32_t)pixel[FI_RGBA_RED]) |
+					((uint32_t)pixel[FI_RGBA_GREEN] << 8) |
+					((uint32_t)pixel[FI_RGBA_BLUE] << 16) |
+					((uint32_t)pixel[FI_RGBA_ALPHA] << 24);
+			}
+		}
+		
+		FreeImage_Unload(image);
+		this->buildmips();
+	}
+	
+	void textureimage_t::buildmips()
+	{
+		this->_levels.clear();
+		if (this->_pixels.empty())
+		{
+			return;
+		}
+		
+		level_t top;
+		top._offset = 0;
+		top._width = this->_width;
+		top._height = this->_height;
+		this->_levels.push_back(top);
+		size_t total = this->_pixels.size();
+		while (top._width > 1 || top._height > 1)
+		{
+			level_t next;
+			next._offset = total;
+			next._width = std::max(top._width / 2, (size_t)1);
+			next._height = std::max(top._height / 2, (size_t)1);
+			total += next._width * next._height;
+			this->_levels.push_back(next);
+			top = next;
+		}
+		
+		this->_pixels.resize(total);
+		for (size_t i = 1; i < this->_levels.size(); i++)
+		{
+			const level_t& src = this->_levels[i - 1];
+			const level_t& dst = this->_levels[i];
+			for (size_t y = 0; y < dst._height; y++)
+			{
+				size_t y0 = std::min(y * 2, src._height - 1);
+				size_t y1 = std::min((y * 2) + 1, src._height - 1);
+				for (size_t x = 0; x < dst._width; x++)
 				{
-					return
-						(unpack(pixel0.rgbRed, pixel0.rgbGreen, pixel0.rgbBlue, pixel0.rgbReserved) * glm::length(linear0)) +
-						(unpack(pixel1.rgbRed, pixel1.rgbGreen, pixel1.rgbBlue, pixel1.rgbReserved) * glm::length(linear1)) +
-						(unpack(pixel2.rgbRed, pixel2.rgbGreen, pixel2.rgbBlue, pixel2.rgbReserved) * glm::length(linear2)) +
-						(unpack(pixel3.rgbRed, pixel3.rgbGreen, pixel3.rgbBlue, pixel3.rgbReserved) * glm::length(linear3));
+					size_t x0 = std::min(x * 2, src._width - 1);
+					size_t x1 = std::min((x * 2) + 1, src._width - 1);
+					uint32_t p0 = this->_pixels[src._offset + (y0 * src._width) + x0];
+					uint32_t p1 = this->_pixels[src._offset + (y0 * src._width) + x1];
+					uint32_t p2 = this->_pixels[src._offset + (y1 * src._width) + x0];
+					uint32_t p3 = this->_pixels[src._offset + (y1 * src._width) + x1];
+					uint32_t pixel = 0;
+					for (uint32_t shift = 0; shift < 32; shift += 8)
+					{
+						uint32_t sum = ((p0 >> shift) & 0xff) + ((p1 >> shift) & 0xff) + ((p2 >> shift) & 0xff) + ((p3 >> shift) & 0xff);
+						pixel |= ((sum + 2) / 4) << shift;
+					}
+					
+					this->_pixels[dst._offset + (y * dst._width) + x] = pixel;
 				}
 			}
 		}
-		
-		return glm::vec4(0.0f);
 	}
 	
-	glm::vec4 texturefilter_t::unpack(const uint8_t red, const uint8_t green, const uint8_t blue, const uint8_t alpha)
+	glm::vec4 textureimage_t::unpack(const uint32_t pixel)
 	{
 		return glm::vec4(
-			((float)red) / 255.0f,
-			((float)green) / 255.0f,
-			((float)blue) / 255.0f,
-			((float)alpha) / 255.0f
+			bytetable._values[pixel & 0xff],
+			bytetable._values[(pixel >> 8) & 0xff],
+			bytetable._values[(pixel >> 16) & 0xff],
+			bytetable._values[pixel >> 24]
 		);
 	}
 	
+	glm::vec4 texturefilter_t::sample(const glm::vec2& texcoord, const float footprint) const
+	{
+		if (this->empty())
+		{
+			return glm::vec4(0.0f);
+		}
+		
+		const textureimage_t& image = *this->_image;
+		float lod = footprint > 0.0f ? log2(footprint * float(std::max(image.width(), image.height()))) : 0.0f;
+		if (lod <= 0.0f || image.levels() == 1)
+		{
+			return this->sample(image.level(0), texcoord);
+		}
+		
+		lod = std::min(lod, float(image.levels() - 1));
+		if (this->_type == SAMPLETYPE_LINEAR)
+		{
+			size_t level = (size_t)lod;
+			size_t next = std::min(level + 1, image.levels() - 1);
+			float weight = lod - float(level);
+			return (this->sample(image.level(level), texcoord) * (1.0f - weight)) + (this->sample(image.level(next), texcoord) * weight);
+		}
+		
+		return this->sample(image.level((size_t)(lod + 0.5f)), texcoord);
+	}
+	
+	glm::vec4 texturefilter_t::sample(const textureimage_t::level_t& level, const glm::vec2& texcoord) const
+	{
+		float u = std::min(std::max(texcoord.x, 0.0f), 1.0f) * float(level._width);
+		float v = std::min(std::max(texcoord.y, 0.0f), 1.0f) * float(level._height);
+		if (this->_type == SAMPLETYPE_LINEAR)
+		{
+			// Weighs the four pixels around the coordinate by how close their centers are to it.
+			float x = std::max(u - 0.5f, 0.0f);
+			float y = std::max(v - 0.5f, 0.0f);
+			size_t x0 = std::min((size_t)x, level._width - 1);
+			size_t y0 = std::min((size_t)y, level._height - 1);
+			size_t x1 = std::min(x0 + 1, level._width - 1);
+			size_t y1 = std::min(y0 + 1, level._height - 1);
+			float fx = x - float(x0);
+			float fy = y - float(y0);
+			return
+				(this->_image->texel(level, x0, y0) * ((1.0f - fx) * (1.0f - fy))) +
+				(this->_image->texel(level, x1, y0) * (fx * (1.0f - fy))) +
+				(this->_image->texel(level, x0, y1) * ((1.0f - fx) * fy)) +
+				(this->_image->texel(level, x1, y1) * (fx * fy));
+		}
+		
+		return this->_image->texel(level, std::min((size_t)u, level._width - 1), std::min((size_t)v, level._height - 1));
+	}
+	
 }
\ No newline at end of file
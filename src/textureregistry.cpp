@@ -0,0 +1,101 @@
+#include "../include/RayTracer.h"
+
+namespace ray
+{
+	
+	std::shared_ptr<const textureimage_t> textureregistry_t::acquire(const std::string& filename)
+	{
+		std::string key = resolve(filename);
+		std::map<std::string, size_t>::const_iterator found = this->_lookup.find(key);
+		if (found != this->_lookup.end())
+		{
+			return this->_entries[found->second]._image;
+		}
+		
+		entry_t entry;
+		entry._filename = key;
+		entry._image = std::make_shared<textureimage_t>();
+		entry._decoded = false;
+		this->_lookup[key] = this->_entries.size();
+		this->_entries.push_back(entry);
+		return entry._image;
+	}
+	
+	size_t textureregistry_t::decode(threadpool_t& pool)
+	{
+		std::vector<entry_t*> pending;
+		for (std::vector<entry_t>::iterator i = this->_entries.begin(); i != this->_entries.end(); ++i)
+		{
+			if (!i->_decoded)
+			{
+				pending.push_back(&(*i));
+			}
+		}
+		
+		pool.dispatch(pending.size(), [&pending](const size_t index, const size_t worker)
+		{
+			entry_t* entry = pending[index];
+			std::string filetype = entry->_filename.substr(entry->_filename.find_last_of('.') + 1);
+			IMAGETYPE* image = 0;
+			if (filetype == "png") { image = FreeImage_Load(FIF_PNG, entry->_filename.c_str(), PNG_DEFAULT); }
+			else if (filetype == "jpg" || filetype == "jpeg") { image = FreeImage_Load(FIF_JPEG, entry->_filename.c_str(), JPEG_DEFAULT); }
+			
+			entry->_image->decode(image);
+			entry->_decoded = true;
+			if (image != 0)
+			{
+				FreeImage_Unload(image);
+			}
+			else
+			{
+				printf("Could not load texture: %s\n", entry->_filename.c_str());
+			}
+		});
+		
+		return pending.size();
+	}
+	
+	size_t textureregistry_t::pending() const
+	{
+		size_t count = 0;
+		for (std::vector<entry_t>::const_iterator i = this->_entries.begin(); i != this->_entries.end(); ++i)
+		{
+			count += i->_decoded ? 0 : 1;
+		}
+		
+		return count;
+	}
+	
+	size_t textureregistry_t::bytes() const
+	{
+		size_t count = 0;
+		for (std::vector<entry_t>::const_iterator i = this->_entries.begin(); i != this->_entries.end(); ++i)
+		{
+			count += i->_image->bytes();
+		}
+		
+		return count;
+	}
+	
+	std::string textureregistry_t::resolve(const std::string& filename)
+	{
+#if defined(_WIN32)
+		char path[_MAX_PATH];
+		if (_fullpath(path, filename.c_str(), _MAX_PATH) != 0)
+		{
+			return std::string(path);
+		}
+#else
+		char* path = realpath(filename.c_str(), 0);
+		if (path != 0)
+		{
+			std::string resolved(path);
+			free(path);
+			return resolved;
+		}
+#endif
+		
+		return filename;
+	}
+	
+}
\ No newline at end of file
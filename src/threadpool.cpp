@@ -0,0 +1,140 @@
+#include "../include/RayTracer.h"
+
+namespace ray
+{
+
+	threadpool_t::threadpool_t(const size_t threads) :
+		_queues(threads > 0 ? threads : concurrency()),
+		_stats(_queues.size()),
+		_elapsed(0.0),
+		_task(0),
+		_generation(0),
+		_pending(0),
+		_exit(false)
+	{
+		for (size_t i = 0; i < this->_queues.size(); i++)
+		{
+			this->_workers.push_back(std::thread(&threadpool_t::work, this, i));
+		}
+	}
+	threadpool_t::~threadpool_t()
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			this->_exit = true;
+		}
+
+		this->_wake.notify_all();
+		for (std::vector<std::thread>::iterator i = this->_workers.begin(); i != this->_workers.end(); i++)
+		{
+			i->join();
+		}
+	}
+
+	void threadpool_t::dispatch(const size_t count, const task_t& task)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::unique_lock<std::mutex> lock(this->_mutex);
+		size_t workers = this->_queues.size();
+		for (size_t i = 0; i < workers; i++)
+		{
+			std::unique_lock<std::mutex> queue(this->_queues[i]._mutex);
+			this->_queues[i]._indices.clear();
+			for (size_t k = (count * i) / workers; k < (count * (i + 1)) / workers; k++)
+			{
+				this->_queues[i]._indices.push_back(k);
+			}
+
+			this->_stats[i] = workerstats_t();
+		}
+
+		this->_task = &task;
+		this->_pending = workers;
+		this->_generation++;
+		this->_wake.notify_all();
+		this->_done.wait(lock, [this]() { return this->_pending == 0; });
+		this->_task = 0;
+		this->_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	size_t threadpool_t::concurrency()
+	{
+		return std::max((size_t)std::thread::hardware_concurrency(), (size_t)1);
+	}
+
+	bool threadpool_t::take(const size_t worker, size_t& index, bool& stolen)
+	{
+		{
+			workqueue_t& own = this->_queues[worker];
+			std::unique_lock<std::mutex> lock(own._mutex);
+			if (!own._indices.empty())
+			{
+				index = own._indices.front();
+				own._indices.pop_front();
+				stolen = false;
+				return true;
+			}
+		}
+
+		size_t workers = this->_queues.size();
+		for (size_t i = 1; i < workers; i++)
+		{
+			workqueue_t& victim = this->_queues[(worker + i) % workers];
+			std::unique_lock<std::mutex> lock(victim._mutex);
+			if (!victim._indices.empty())
+			{
+				index = victim._indices.back();
+				victim._indices.pop_back();
+				stolen = true;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void threadpool_t::work(const size_t worker)
+	{
+		size_t generation = 0;
+		for (;;)
+		{
+			const task_t* task = 0;
+			{
+				std::unique_lock<std::mutex> lock(this->_mutex);
+				this->_wake.wait(lock, [this, generation]() { return this->_exit || this->_generation != generation; });
+				if (this->_exit)
+				{
+					return;
+				}
+
+				generation = this->_generation;
+				task = this->_task;
+			}
+
+			workerstats_t stats;
+			size_t index = 0;
+			bool stolen = false;
+			while (this->take(worker, index, stolen))
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				(*task)(index, worker);
+				stats._busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				stats._tasks++;
+				stats._steals += stolen ? 1 : 0;
+			}
+
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			this->_stats[worker] = stats;
+			if (--this->_pending == 0)
+			{
+				this->_done.notify_all();
+			}
+		}
+	}
+
+}